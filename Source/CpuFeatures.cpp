@@ -0,0 +1,242 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#elif defined( __x86_64__ ) || defined( __i386__ )
+#include <cpuid.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+#include "CpuFeatures.h"
+
+//==============================================================================
+
+#if defined( _M_X64 ) || defined( __x86_64__ ) || defined( _M_IX86 ) || defined( __i386__ )
+
+// Execute CPUID for a leaf/sub-leaf. regs = EAX, EBX, ECX, EDX
+static void cpuid( int leaf, int subleaf, uint32_t regs[ 4 ] )
+{
+#if defined( _MSC_VER )
+	int info[ 4 ];
+	__cpuidex( info, leaf, subleaf );
+	for ( int i = 0; i < 4; ++i )
+	{
+		regs[ i ] = static_cast< uint32_t >( info[ i ] );
+	}
+#else
+	__cpuid_count( leaf, subleaf, regs[ 0 ], regs[ 1 ], regs[ 2 ], regs[ 3 ] );
+#endif
+}
+
+// Read the OS-enabled register state mask (XCR0).
+static uint64_t xgetbv0()
+{
+#if defined( _MSC_VER )
+	return _xgetbv( 0 );
+#else
+	uint32_t eax, edx;
+	__asm__ __volatile__( "xgetbv" : "=a"( eax ), "=d"( edx ) : "c"( 0 ) );
+	return ( static_cast< uint64_t >( edx ) << 32 ) | eax;
+#endif
+}
+
+static void detect( CpuFeatures& features )
+{
+	uint32_t regs[ 4 ];
+
+	cpuid( 0, 0, regs );
+	const uint32_t maxLeaf = regs[ 0 ];
+
+	// "AuthenticAMD" in EBX, EDX, ECX
+	const bool bAMD = ( regs[ 1 ] == 0x68747541 ) && ( regs[ 3 ] == 0x69746E65 ) && ( regs[ 2 ] == 0x444D4163 );
+
+	if ( maxLeaf < 1 )
+	{
+		return;
+	}
+
+	cpuid( 1, 0, regs );
+	features.bSSE2 = ( regs[ 3 ] & ( 1 << 26 ) ) != 0;
+
+	uint32_t family = ( regs[ 0 ] >> 8 ) & 0xF;
+	if ( family == 0xF )
+	{
+		family += ( regs[ 0 ] >> 20 ) & 0xFF;
+	}
+
+	// AVX state must be enabled by the OS (OSXSAVE, then XMM + YMM in XCR0)
+	const bool bOSXSAVE = ( regs[ 2 ] & ( 1 << 27 ) ) != 0;
+	const uint64_t xcr0 = bOSXSAVE ? xgetbv0() : 0;
+	const bool bYMM = ( xcr0 & 0x6 ) == 0x6;
+	const bool bZMM = ( xcr0 & 0xE6 ) == 0xE6;
+
+	if ( maxLeaf >= 7 )
+	{
+		cpuid( 7, 0, regs );
+		features.bAVX2 = bYMM && ( regs[ 1 ] & ( 1 << 5 ) ) != 0;
+
+		// ... F (bit 16), BW (bit 30), VL (bit 31), and opmask + ZMM state in XCR0.
+		const uint32_t uAVX512 = ( 1u << 16 ) | ( 1u << 30 ) | ( 1u << 31 );
+		features.bAVX512 = bZMM && ( regs[ 1 ] & uAVX512 ) == uAVX512;
+
+		// ... Zen 3 is family 19h.
+		const bool bSlowPDEP = bAMD && ( family < 0x19 );
+		features.bBMI2 = ( regs[ 1 ] & ( 1 << 8 ) ) != 0 && ( bSlowPDEP == false );
+	}
+}
+
+#else
+
+static void detect( CpuFeatures& features )
+{
+	// Not x86, no extensions.
+}
+
+#endif
+
+static CpuFeatures gFeatures;
+static bool gbDetected = false;
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// GetCpuFeatures
+//------------------------------------------------------------------------------
+const CpuFeatures& GetCpuFeatures()
+{
+	if ( gbDetected == false )
+	{
+		detect( gFeatures );
+		gbDetected = true;
+	}
+
+	return gFeatures;
+}
+
+//------------------------------------------------------------------------------
+// LimitCpuFeatures
+//------------------------------------------------------------------------------
+bool LimitCpuFeatures( CpuLevel level )
+{
+	const CpuFeatures& features = GetCpuFeatures();
+
+	bool bSupported;
+	switch ( level )
+	{
+
+	default:
+	case CpuLevel::SCALAR:
+		bSupported = true;
+		break;
+
+	case CpuLevel::SSE2:
+		bSupported = features.bSSE2;
+		break;
+
+	case CpuLevel::AVX2:
+		bSupported = features.bAVX2;
+		break;
+
+	case CpuLevel::AVX512:
+		bSupported = features.bAVX512;
+		break;
+
+	}
+
+	// ... BMI2 arrived with AVX2, so it goes with it.
+	if ( level < CpuLevel::AVX512 )
+	{
+		gFeatures.bAVX512 = false;
+	}
+	if ( level < CpuLevel::AVX2 )
+	{
+		gFeatures.bAVX2 = false;
+		gFeatures.bBMI2 = false;
+	}
+	if ( level < CpuLevel::SSE2 )
+	{
+		gFeatures.bSSE2 = false;
+	}
+
+	return bSupported;
+}
+
+//------------------------------------------------------------------------------
+// DecodeCpuLevel
+//------------------------------------------------------------------------------
+bool DecodeCpuLevel( const char* pArg, CpuLevel& level )
+{
+	if ( _stricmp( pArg, "scalar" ) == 0 )
+	{
+		level = CpuLevel::SCALAR;
+	}
+	else if ( _stricmp( pArg, "sse2" ) == 0 )
+	{
+		level = CpuLevel::SSE2;
+	}
+	else if ( _stricmp( pArg, "avx2" ) == 0 )
+	{
+		level = CpuLevel::AVX2;
+	}
+	else if ( _stricmp( pArg, "avx512" ) == 0 )
+	{
+		level = CpuLevel::AVX512;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// CpuLevelToString
+//------------------------------------------------------------------------------
+const char* CpuLevelToString( CpuLevel level )
+{
+	switch ( level )
+	{
+
+	case CpuLevel::SCALAR:
+		return "scalar";
+
+	case CpuLevel::SSE2:
+		return "SSE2";
+
+	case CpuLevel::AVX2:
+		return "AVX2";
+
+	case CpuLevel::AVX512:
+		return "AVX-512";
+
+	}
+
+	return nullptr;
+}
+
+//==============================================================================
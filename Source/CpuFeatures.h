@@ -0,0 +1,62 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+// Instruction set extensions available on the host CPU.
+
+struct CpuFeatures
+{
+	bool bSSE2 = false;
+	bool bAVX2 = false;
+
+	// AVX-512 F + BW + VL
+	bool bAVX512 = false;
+
+	// BMI2 with fast PDEP/PEXT. Not set on AMD before Zen 3, where they're microcoded.
+	bool bBMI2 = false;
+};
+
+// Kernel levels, for the -cpu option. Each level includes the ones below it.
+enum class CpuLevel
+{
+	SCALAR,
+	SSE2,
+	AVX2,
+	AVX512,
+};
+
+// Detect the host CPU's features. Detection runs once, on the first call.
+const CpuFeatures& GetCpuFeatures();
+
+// Turn off any features above a level. Returns false if the CPU doesn't reach it.
+// Call before BindRowKernels.
+bool LimitCpuFeatures( CpuLevel level );
+
+// Helper to decode a string into a CPU level (case insensitive).
+// Returns false if it's not recognised.
+bool DecodeCpuLevel( const char* pArg, CpuLevel& level );
+
+// Print a CPU level as text
+const char* CpuLevelToString( CpuLevel level );
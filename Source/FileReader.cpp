@@ -22,40 +22,339 @@ SOFTWARE.
 
 */
 
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined( _WIN32 )
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "FileReader.h"
 
+// Chunk size when reading a stream of unknown length.
+static const size_t kStreamChunk = 65536;
+
+// How many chunks a stream is read, or a mapped file paged in, ahead of the decoder.
+static const size_t kReadAheadChunks = 4;
+
+// A stream being read on its own thread, so waiting on a pipe or a slow disk
+// overlaps with decoding what's already arrived.
+struct StreamReadAhead
+{
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque< std::vector< uint8_t > > chunks;
+	bool bEnded = false;
+	bool bError = false;
+	bool bStop = false;
+	std::thread thread;
+};
+
+// The read-ahead thread. It owns the stream, unless it's stdin.
+static void readAhead( std::shared_ptr< StreamReadAhead > pAhead, FILE* fp )
+{
+	for ( ;; )
+	{
+		{
+			std::unique_lock< std::mutex > lock( pAhead->mutex );
+			pAhead->cv.wait( lock, [ & ] { return pAhead->bStop || pAhead->chunks.size() < kReadAheadChunks; } );
+			if ( pAhead->bStop )
+			{
+				break;
+			}
+		}
+
+		// ... the descriptor is read directly, taking what's arrived, so stdio's
+		// lock on the stream isn't held while it waits.
+		std::vector< uint8_t > chunk( kStreamChunk );
+#if defined( _WIN32 )
+		const int count = _read( _fileno( fp ), chunk.data(), static_cast< unsigned int >( chunk.size() ) );
+#else
+		ssize_t count;
+		do
+		{
+			count = read( fileno( fp ), chunk.data(), chunk.size() );
+		}
+		while ( count < 0 && errno == EINTR );
+#endif
+
+		std::lock_guard< std::mutex > lock( pAhead->mutex );
+
+		// End of the stream?
+		if ( count <= 0 )
+		{
+			pAhead->bEnded = true;
+			pAhead->bError = count < 0;
+			pAhead->cv.notify_all();
+			break;
+		}
+
+		chunk.resize( static_cast< size_t >( count ) );
+
+		pAhead->chunks.push_back( std::move( chunk ) );
+		pAhead->cv.notify_all();
+	}
+
+	if ( fp != stdin )
+	{
+		fclose( fp );
+	}
+}
+
+// Map a whole file read-only. If it's open but can't be mapped, e.g. it's a pipe
+// or empty, returns nullptr and a stream to read it from instead.
+static uint8_t* mapFile( const char* pFileName, size_t& length, FILE** pp_stream )
+{
+	*pp_stream = nullptr;
+
+#if defined( _WIN32 )
+	HANDLE hFile = CreateFileA( pFileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+	if ( hFile == INVALID_HANDLE_VALUE )
+	{
+		return nullptr;
+	}
+
+	LARGE_INTEGER size;
+	void* p = nullptr;
+	if ( GetFileType( hFile ) == FILE_TYPE_DISK && GetFileSizeEx( hFile, &size ) && size.QuadPart > 0 && size.QuadPart < 0xFFFFFFFF )
+	{
+		HANDLE hMapping = CreateFileMappingA( hFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if ( hMapping )
+		{
+			// ... the view keeps the mapping alive.
+			p = MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+			CloseHandle( hMapping );
+		}
+
+		length = static_cast< size_t >( size.QuadPart );
+	}
+
+	CloseHandle( hFile );
+
+	if ( p == nullptr )
+	{
+		fopen_s( pp_stream, pFileName, "rb" );
+	}
+#else
+	const int fd = open( pFileName, O_RDONLY );
+	if ( fd < 0 )
+	{
+		return nullptr;
+	}
+
+	struct stat st;
+	void* p = nullptr;
+	if ( fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > 0 && st.st_size < 0xFFFFFFFF )
+	{
+		length = static_cast< size_t >( st.st_size );
+
+#ifdef POSIX_FADV_WILLNEED
+		// ... start reading the whole file now, so a cold disk is busy while
+		// the decoder works, rather than waiting on each fault.
+		posix_fadvise( fd, 0, 0, POSIX_FADV_WILLNEED );
+#endif
+
+		p = mmap( nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+		if ( p == MAP_FAILED )
+		{
+			p = nullptr;
+		}
+#ifdef MADV_SEQUENTIAL
+		else
+		{
+			// ... only a hint, to read ahead and drop pages behind.
+			madvise( p, length, MADV_SEQUENTIAL );
+		}
+#endif
+	}
+
+	if ( p == nullptr )
+	{
+		// ... a pipe can only be opened once, so keep reading this one.
+		*pp_stream = fdopen( fd, "rb" );
+		if ( *pp_stream )
+		{
+			return nullptr;
+		}
+	}
+
+	// ... the mapping outlives the descriptor.
+	close( fd );
+#endif
+
+	return reinterpret_cast< uint8_t* >( p );
+}
+
+static void unmapFile( uint8_t* p, size_t length )
+{
+#if defined( _WIN32 )
+	UnmapViewOfFile( p );
+#else
+	munmap( p, length );
+#endif
+}
+
 FileReader::~FileReader()
 {
-	free( _pData );
+	Close();
 }
 
-bool FileReader::LoadFile( const char* pFileName )
+void FileReader::Close()
 {
+	if ( _bMapped )
+	{
+		unmapFile( _pData, _length );
+	}
+	else
+	{
+		free( _pData );
+	}
+
+	endStream();
+
+	_pData = nullptr;
 	_cursor = 0;
+	_length = 0;
+	_capacity = 0;
+	_prefetched = 0;
+	_bMapped = false;
+}
 
+void FileReader::endStream()
+{
+	if ( _pReadAhead == nullptr )
+	{
+		return;
+	}
+
+	bool bEnded;
+	{
+		std::lock_guard< std::mutex > lock( _pReadAhead->mutex );
+		_pReadAhead->bStop = true;
+		bEnded = _pReadAhead->bEnded;
+	}
+	_pReadAhead->cv.notify_all();
+
+	// ... a thread still blocked on a pipe is left to finish on its own.
+	if ( bEnded )
+	{
+		_pReadAhead->thread.join();
+	}
+	else
+	{
+		_pReadAhead->thread.detach();
+	}
+
+	_pReadAhead.reset();
+}
+
+bool FileReader::LoadFile( const char* pFileName )
+{
+	Close();
+
+	// "-" is stdin.
+	if ( strcmp( pFileName, "-" ) == 0 )
+	{
+#if defined( _WIN32 )
+		_setmode( _fileno( stdin ), _O_BINARY );
+#endif
+		return LoadStream( stdin );
+	}
+
+	// Files are mapped, and paged in as they're read.
+	size_t length = 0;
 	FILE* fp;
-	if ( fopen_s( &fp, pFileName, "rb" ) == 0 )
+	_pData = mapFile( pFileName, length, &fp );
+	if ( _pData )
+	{
+		_length = static_cast< uint32_t >( length );
+		_bMapped = true;
+		return true;
+	}
+
+	// Otherwise, fall back to reading it as a stream.
+	if ( fp == nullptr )
+	{
+		return false;
+	}
+
+	return LoadStream( fp );
+}
+
+bool FileReader::LoadStream( FILE* fp )
+{
+	_pReadAhead = std::make_shared< StreamReadAhead >();
+	_pReadAhead->thread = std::thread( readAhead, _pReadAhead, fp );
+
+	// Enough to identify the image. The rest is read as it's needed.
+	return fetch( kStreamChunk );
+}
+
+bool FileReader::fetch( uint32_t end )
+{
+	while ( _pReadAhead && _length <= end )
 	{
-		size_t length;
-		fseek( fp, 0, SEEK_END );
-		length = ftell( fp );
-		fseek( fp, 0, SEEK_SET );
+		std::vector< uint8_t > chunk;
+		{
+			std::unique_lock< std::mutex > lock( _pReadAhead->mutex );
+			_pReadAhead->cv.wait( lock, [ & ] { return _pReadAhead->chunks.empty() == false || _pReadAhead->bEnded; } );
+
+			// End of the stream?
+			if ( _pReadAhead->chunks.empty() )
+			{
+				const bool bError = _pReadAhead->bError;
+				lock.unlock();
+
+				endStream();
+				return bError == false;
+			}
+
+			chunk = std::move( _pReadAhead->chunks.front() );
+			_pReadAhead->chunks.pop_front();
+		}
+		_pReadAhead->cv.notify_all();
 
-		_pData = (uint8_t*)malloc( length );
-		if ( _pData )
+		if ( _length + chunk.size() > _capacity )
 		{
-			_length = (uint32_t)length;
+			// ... the whole stream is kept, so Seek can go back.
+			size_t capacity = std::max< size_t >( _capacity, kStreamChunk );
+			while ( capacity < _length + chunk.size() )
+			{
+				capacity *= 2;
+			}
 
-			fread( _pData, 1, length, fp );
-			fclose( fp );
-			return true;
+			uint8_t* pData = reinterpret_cast< uint8_t* >( realloc( _pData, capacity ) );
+			if ( pData == nullptr || capacity >= 0xFFFFFFFF )
+			{
+				_pData = pData ? pData : _pData;
+				Close();
+				return false;
+			}
+
+			_pData = pData;
+			_capacity = static_cast< uint32_t >( capacity );
 		}
+
+		memcpy( _pData + _length, chunk.data(), chunk.size() );
+		_length += static_cast< uint32_t >( chunk.size() );
 	}
 
-	return false;
+	return true;
 }
 
 bool FileReader::IsSafeRequest( uint32_t count ) const
@@ -68,8 +367,36 @@ bool FileReader::IsSafeRequest( uint32_t count ) const
 	return true;
 }
 
+void FileReader::prefetch()
+{
+	if ( _bMapped == false || _prefetched >= _length || _cursor + kReadAheadChunks * kStreamChunk <= _prefetched )
+	{
+		return;
+	}
+
+	// ... whole chunks, so the start is always page aligned.
+	const size_t chunk = _cursor / kStreamChunk;
+	const size_t start = std::max< size_t >( _prefetched, chunk * kStreamChunk );
+	const size_t end = std::min< size_t >( ( chunk + kReadAheadChunks + 1 ) * kStreamChunk, _length );
+
+#if defined( _WIN32 )
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = _pData + start;
+	range.NumberOfBytes = end - start;
+	PrefetchVirtualMemory( GetCurrentProcess(), 1, &range, 0 );
+#elif defined( MADV_WILLNEED )
+	madvise( _pData + start, end - start, MADV_WILLNEED );
+#endif
+
+	_prefetched = static_cast< uint32_t >( end );
+}
+
 bool FileReader::Read( uint8_t* pTarget, uint32_t count )
 {
+	// Streams are read a chunk ahead of the cursor, and mappings paged in.
+	fetch( _cursor + count + kStreamChunk );
+	prefetch();
+
 	if ( _cursor + count >= _length )
 	{
 		return false;
@@ -80,3 +407,32 @@ bool FileReader::Read( uint8_t* pTarget, uint32_t count )
 	return true;
 }
 
+uint32_t FileReader::ReadChunk( const uint8_t** pp_data, uint32_t count )
+{
+	// Streams hand over what's arrived, and only wait if that's nothing.
+	if ( _cursor >= _length )
+	{
+		fetch( _cursor );
+	}
+
+	// The disk reads ahead while this chunk is inflated.
+	prefetch();
+
+	count = std::min( count, _length - _cursor );
+
+	*pp_data = _pData + _cursor;
+	_cursor += count;
+	return count;
+}
+
+bool FileReader::Seek( uint32_t offset )
+{
+	if ( offset >= _length )
+	{
+		return false;
+	}
+
+	_cursor = offset;
+	return true;
+}
+
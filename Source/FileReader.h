@@ -25,7 +25,11 @@ SOFTWARE.
 #pragma once
 
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <memory>
+
+struct StreamReadAhead;
 
 class FileReader
 {
@@ -36,7 +40,10 @@ public:
 
 		_pData( nullptr ),
 		_cursor( 0 ),
-		_length( 0 )
+		_length( 0 ),
+		_capacity( 0 ),
+		_prefetched( 0 ),
+		_bMapped( false )
 
 	{
 		//
@@ -46,14 +53,27 @@ public:
 
 public:
 
+	// Map the file into memory. If it can't be mapped (e.g. a pipe), or it's "-"
+	// for stdin, it's read as a stream instead, on another thread, a few chunks
+	// ahead of the cursor.
 	bool LoadFile( const char* pFileName );
 
+	void Close();
+
 public:
 
 	bool IsSafeRequest( uint32_t count ) const;
 	
 	bool Read( uint8_t* pTarget, uint32_t count );
 
+	// Point at up to 'count' bytes from the cursor, and move past them, without
+	// copying. Returns how many there are: fewer near the end, or if a stream
+	// has only that many so far, and 0 after the end.
+	// The pointer is only good until the next call.
+	uint32_t ReadChunk( const uint8_t** pp_data, uint32_t count );
+
+	bool Seek( uint32_t offset );
+
 public:
 
 	// accessors
@@ -74,10 +94,29 @@ public:
 	}
 
 
+private:
+
+	// Start reading a stream of unknown length. Takes ownership, unless it's stdin.
+	bool LoadStream( FILE* fp );
+
+	// Take what's been read from the stream until the buffer holds more than
+	// 'end' bytes, or it ends.
+	bool fetch( uint32_t end );
+
+	// Stop reading the stream.
+	void endStream();
+
+	// Ask for the mapped file to be paged in a little ahead of the cursor.
+	void prefetch();
+
 private:
 
 	uint8_t* _pData;
 	uint32_t _cursor;
 	uint32_t _length;
+	uint32_t _capacity;
+	uint32_t _prefetched; // The mapping is paged in, or on its way, up to here.
+	bool _bMapped; // _pData is a read-only file mapping, not malloc'd.
+	std::shared_ptr< StreamReadAhead > _pReadAhead; // Still reading into _pData from here.
 
 };
@@ -0,0 +1,530 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined( _WIN32 )
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "FileWriter.h"
+
+#if !defined( _WIN32 ) && !defined( IOV_MAX )
+#define IOV_MAX 1024
+#endif
+
+// Suffix of the file written in place of the output, until it's complete.
+static const char* kPartSuffix = ".part";
+
+// Create a new part file beside the output, named for this process so that two
+// runs writing the same output don't share one. Returns nullptr if it can't be
+// made, e.g. the directory isn't writable.
+static FILE* openPart( const std::string& name, std::string& partName )
+{
+#if defined( _WIN32 )
+	const int pid = _getpid();
+#else
+	const int pid = static_cast< int >( getpid() );
+#endif
+
+	for ( int attempt = 0; attempt < 100; ++attempt )
+	{
+		partName = name + "." + std::to_string( pid );
+		if ( attempt )
+		{
+			partName += "-" + std::to_string( attempt );
+		}
+		partName += kPartSuffix;
+
+#if defined( _WIN32 )
+		int fd;
+		if ( _sopen_s( &fd, partName.c_str(), _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE ) == 0 )
+		{
+			FILE* fp = _fdopen( fd, "wb" );
+			if ( fp == nullptr )
+			{
+				_close( fd );
+				remove( partName.c_str() );
+			}
+			return fp;
+		}
+#else
+		const int fd = open( partName.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0666 );
+		if ( fd >= 0 )
+		{
+			FILE* fp = fdopen( fd, "wb" );
+			if ( fp == nullptr )
+			{
+				close( fd );
+				remove( partName.c_str() );
+			}
+			return fp;
+		}
+#endif
+
+		// ... a stale one from a run with the same id? Try the next name.
+		if ( errno != EEXIST )
+		{
+			break;
+		}
+	}
+
+	partName.clear();
+	return nullptr;
+}
+
+// Do two files hold the same bytes?
+static bool sameContents( const char* pNameA, const char* pNameB )
+{
+	// ... no need to read them if the sizes differ.
+#if defined( _WIN32 )
+	struct _stat64 stA, stB;
+	if ( _stat64( pNameA, &stA ) != 0 || _stat64( pNameB, &stB ) != 0 || stA.st_size != stB.st_size )
+#else
+	struct stat stA, stB;
+	if ( stat( pNameA, &stA ) != 0 || stat( pNameB, &stB ) != 0 || stA.st_size != stB.st_size )
+#endif
+	{
+		return false;
+	}
+
+	FILE* fpA;
+	FILE* fpB;
+	if ( fopen_s( &fpA, pNameA, "rb" ) != 0 )
+	{
+		return false;
+	}
+	if ( fopen_s( &fpB, pNameB, "rb" ) != 0 )
+	{
+		fclose( fpA );
+		return false;
+	}
+
+	bool bSame = true;
+
+	uint8_t bufferA[ 65536 ];
+	uint8_t bufferB[ 65536 ];
+	for ( ;; )
+	{
+		const size_t countA = fread( bufferA, 1, sizeof( bufferA ), fpA );
+		const size_t countB = fread( bufferB, 1, sizeof( bufferB ), fpB );
+		if ( countA != countB || memcmp( bufferA, bufferB, countA ) != 0 )
+		{
+			bSame = false;
+			break;
+		}
+
+		if ( countA == 0 )
+		{
+			bSame = ferror( fpA ) == 0 && ferror( fpB ) == 0;
+			break;
+		}
+	}
+
+	fclose( fpA );
+	fclose( fpB );
+
+	return bSame;
+}
+
+// Make sure a file's contents are on disk, so a rename can't land before them.
+static bool syncFile( FILE* fp )
+{
+#if defined( _WIN32 )
+	return _commit( _fileno( fp ) ) == 0;
+#else
+	return fsync( fileno( fp ) ) == 0;
+#endif
+}
+
+// Replace one file with another, in one step where the OS allows. The new file
+// takes on the old one's permissions and, where allowed, its owner.
+static bool replaceFile( const char* pFrom, const char* pTo )
+{
+#if defined( _WIN32 )
+	return MoveFileExA( pFrom, pTo, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) != 0;
+#else
+	struct stat st;
+	if ( stat( pTo, &st ) == 0 )
+	{
+		if ( chmod( pFrom, st.st_mode & 07777 ) != 0 )
+		{
+			return false;
+		}
+
+		if ( chown( pFrom, st.st_uid, st.st_gid ) != 0 )
+		{
+			// ... only root can give a file away; it's ours now.
+		}
+	}
+
+	return rename( pFrom, pTo ) == 0;
+#endif
+}
+
+// Can a file be written beside the target and then renamed over it? Not if the
+// target is a device, a pipe, or a link, which must be written through, nor if
+// it's read-only, which must fail as it always has.
+static bool canReplace( const char* pFileName )
+{
+#if defined( _WIN32 )
+	struct _stat st;
+	if ( _stat( pFileName, &st ) != 0 )
+	{
+		return true; // ... new file
+	}
+
+	const DWORD attributes = GetFileAttributesA( pFileName );
+	return ( st.st_mode & _S_IFREG ) && ( st.st_mode & _S_IWRITE ) && ( attributes == INVALID_FILE_ATTRIBUTES || ( attributes & FILE_ATTRIBUTE_REPARSE_POINT ) == 0 );
+#else
+	struct stat st;
+	if ( lstat( pFileName, &st ) != 0 )
+	{
+		return true; // ... new file
+	}
+
+	return S_ISREG( st.st_mode ) && access( pFileName, W_OK ) == 0;
+#endif
+}
+
+FileWriter::~FileWriter()
+{
+	Discard();
+}
+
+bool FileWriter::Open( const char* pFileName, bool bAppend )
+{
+	Discard();
+
+	_name = pFileName;
+	_partName.clear();
+	_bError = false;
+	_bUnchanged = false;
+	_written = 0;
+
+	if ( strcmp( pFileName, "-" ) == 0 )
+	{
+		fflush( stdout );
+#if defined( _WIN32 )
+		_setmode( _fileno( stdout ), _O_BINARY );
+#endif
+		_fp = stdout;
+	}
+	else if ( canReplace( pFileName ) && ( _fp = openPart( _name, _partName ) ) != nullptr )
+	{
+		// ... replaced on Close.
+	}
+	else if ( fopen_s( &_fp, pFileName, bAppend ? "ab" : "wb" ) != 0 || _fp == nullptr )
+	{
+		// ... written in place, as there's nowhere beside it to write.
+		_fp = nullptr;
+		return false;
+	}
+
+	// Everything is gathered here, so stdio needn't buffer it again.
+	setvbuf( _fp, nullptr, _IONBF, 0 );
+
+	// Appending starts from a copy. A missing file is fine.
+	FILE* fp_old;
+	if ( bAppend && _partName.empty() == false && fopen_s( &fp_old, pFileName, "rb" ) == 0 )
+	{
+		uint8_t buffer[ 65536 ];
+
+		size_t count;
+		while ( ( count = fread( buffer, 1, sizeof( buffer ), fp_old ) ) > 0 && Flush() )
+		{
+			Write( buffer, count );
+		}
+
+		fclose( fp_old );
+
+		if ( Flush() == false )
+		{
+			Discard();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool FileWriter::OpenTemp()
+{
+	Discard();
+
+	_name.clear();
+	_partName.clear();
+	_bError = false;
+	_bUnchanged = false;
+	_written = 0;
+
+	if ( tmpfile_s( &_fp ) != 0 || _fp == nullptr )
+	{
+		_fp = nullptr;
+		return false;
+	}
+
+	setvbuf( _fp, nullptr, _IONBF, 0 );
+
+	return true;
+}
+
+bool FileWriter::Close()
+{
+	if ( _fp == nullptr )
+	{
+		return _bError == false;
+	}
+
+	Flush();
+
+	// ... the part file has to be whole before it's renamed.
+	if ( _partName.empty() == false && _bError == false && syncFile( _fp ) == false )
+	{
+		_bError = true;
+	}
+
+	if ( ( _fp == stdout ? fflush( _fp ) : fclose( _fp ) ) != 0 )
+	{
+		_bError = true;
+	}
+
+	_fp = nullptr;
+
+	if ( _partName.empty() == false )
+	{
+		if ( _bError )
+		{
+			remove( _partName.c_str() );
+		}
+		else if ( sameContents( _partName.c_str(), _name.c_str() ) )
+		{
+			// ... keep the old file, and its time stamp.
+			remove( _partName.c_str() );
+			_bUnchanged = true;
+		}
+		else if ( replaceFile( _partName.c_str(), _name.c_str() ) == false )
+		{
+			remove( _partName.c_str() );
+			_bError = true;
+		}
+
+		_partName.clear();
+	}
+
+	return _bError == false;
+}
+
+void FileWriter::Discard()
+{
+	if ( _fp == nullptr )
+	{
+		return;
+	}
+
+	_pieces.clear();
+	_copies.clear();
+
+	if ( _fp == stdout )
+	{
+		// ... what's been written can't be taken back.
+		fflush( _fp );
+	}
+	else
+	{
+		fclose( _fp );
+	}
+
+	_fp = nullptr;
+
+	if ( _partName.empty() == false )
+	{
+		remove( _partName.c_str() );
+		_partName.clear();
+	}
+}
+
+void FileWriter::Write( const void* pData, size_t count )
+{
+	if ( count == 0 )
+	{
+		return;
+	}
+
+	const size_t offset = _copies.size();
+	_copies.insert( _copies.end(), static_cast< const uint8_t* >( pData ), static_cast< const uint8_t* >( pData ) + count );
+
+	// Grow the last piece, if it's the copy just before this one.
+	if ( _pieces.empty() == false && _pieces.back().pData == nullptr )
+	{
+		_pieces.back().count += count;
+		return;
+	}
+
+	_pieces.push_back( { nullptr, offset, count } );
+}
+
+void FileWriter::WriteRef( const void* pData, size_t count )
+{
+	if ( count == 0 )
+	{
+		return;
+	}
+
+	const uint8_t* p = static_cast< const uint8_t* >( pData );
+
+	// Grow the last piece, if it ends where this one starts. Packed image rows
+	// become one piece.
+	if ( _pieces.empty() == false && _pieces.back().pData && _pieces.back().pData + _pieces.back().count == p )
+	{
+		_pieces.back().count += count;
+		return;
+	}
+
+	_pieces.push_back( { p, 0, count } );
+}
+
+bool FileWriter::Flush()
+{
+	if ( _fp == nullptr || _pieces.empty() )
+	{
+		return _bError == false;
+	}
+
+#if defined( _WIN32 )
+	// ... unbuffered, so one WriteFile per piece.
+	for ( const Piece& piece : _pieces )
+	{
+		const uint8_t* p = piece.pData ? piece.pData : _copies.data() + piece.offset;
+		if ( fwrite( p, 1, piece.count, _fp ) != piece.count )
+		{
+			_bError = true;
+			break;
+		}
+
+		_written += piece.count;
+	}
+#else
+	const int fd = fileno( _fp );
+	const size_t start = _written;
+
+	std::vector< iovec > iov( _pieces.size() );
+	for ( size_t i = 0; i < _pieces.size(); ++i )
+	{
+		const Piece& piece = _pieces[ i ];
+		iov[ i ].iov_base = const_cast< uint8_t* >( piece.pData ? piece.pData : _copies.data() + piece.offset );
+		iov[ i ].iov_len = piece.count;
+	}
+
+	// ... a short write resumes from where it stopped.
+	size_t first = 0;
+	while ( first < iov.size() )
+	{
+		const int batch = static_cast< int >( std::min< size_t >( iov.size() - first, IOV_MAX ) );
+		const ssize_t written = writev( fd, &iov[ first ], batch );
+		if ( written < 0 )
+		{
+			if ( errno == EINTR )
+			{
+				continue;
+			}
+
+			_bError = true;
+			break;
+		}
+
+		_written += static_cast< size_t >( written );
+
+		size_t remain = static_cast< size_t >( written );
+		while ( first < iov.size() && remain >= iov[ first ].iov_len )
+		{
+			remain -= iov[ first ].iov_len;
+			++first;
+		}
+
+		if ( remain )
+		{
+			iov[ first ].iov_base = static_cast< uint8_t* >( iov[ first ].iov_base ) + remain;
+			iov[ first ].iov_len -= remain;
+		}
+	}
+
+#if defined( SYNC_FILE_RANGE_WRITE )
+	// Start this part on its way to disk while the next is made, rather than
+	// leave all of it to the sync in Close.
+	if ( _partName.empty() == false && _written > start )
+	{
+		sync_file_range( fd, static_cast< off_t >( start ), static_cast< off_t >( _written - start ), SYNC_FILE_RANGE_WRITE );
+	}
+#endif
+#endif
+
+	_pieces.clear();
+	_copies.clear();
+
+	return _bError == false;
+}
+
+bool FileWriter::CopyTo( FileWriter& target )
+{
+	if ( Flush() == false || _fp == nullptr )
+	{
+		return false;
+	}
+
+	const long end = ftell( _fp );
+	rewind( _fp );
+
+	uint8_t buffer[ 65536 ];
+
+	size_t count;
+	while ( ( count = fread( buffer, 1, sizeof( buffer ), _fp ) ) > 0 )
+	{
+		target.Write( buffer, count );
+		if ( target.Flush() == false )
+		{
+			break;
+		}
+	}
+
+	const bool bResult = ferror( _fp ) == 0 && target._bError == false;
+
+	// Back to the end, for any more writes.
+	fseek( _fp, end, SEEK_SET );
+
+	return bResult;
+}
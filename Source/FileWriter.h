@@ -0,0 +1,146 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Gathers everything written to a file, then hands it to the OS in as few calls
+// as possible: one writev on POSIX. Small pieces, such as headers, are copied.
+// Large ones, such as image rows, are only referenced until the next Flush.
+//
+// Named files are written to "<name>.<pid>.part", and only replace the file on
+// Close, unless that can't be made (e.g. a read-only directory), when they're
+// written in place.
+// If nothing has changed, the file is left alone, so its time stamp doesn't
+// trigger rebuilds. A writer that's destroyed without Close leaves it untouched.
+// Devices, pipes and links can't be replaced, so they're written in place.
+
+class FileWriter
+{
+
+public:
+
+	FileWriter() :
+
+		_fp( nullptr ),
+		_bError( false ),
+		_bUnchanged( false ),
+		_written( 0 )
+
+	{
+		//
+	}
+
+	~FileWriter();
+
+	// Writers own their file, so can't be copied.
+	FileWriter( const FileWriter& ) = delete;
+	FileWriter& operator=( const FileWriter& ) = delete;
+
+public:
+
+	// Open a file to write. Appending copies the file's contents first, and
+	// then only ever adds to the end; nothing is seeked. "-" is stdout, which
+	// is always appended to, and never closed.
+	bool Open( const char* pFileName, bool bAppend );
+
+	// Open a temporary file, deleted when closed. It can be read back with CopyTo.
+	bool OpenTemp();
+
+	// Flush, close, and replace the named file if its contents have changed.
+	// Returns false if any write failed, in which case the file is untouched.
+	bool Close();
+
+	// Close without touching the named file.
+	void Discard();
+
+public:
+
+	// Queue a copy of some bytes.
+	void Write( const void* pData, size_t count );
+
+	// Queue some bytes without copying them. They must stay put until Flush.
+	void WriteRef( const void* pData, size_t count );
+
+	// Write everything queued. Returns false if the write failed.
+	bool Flush();
+
+	// Flush, then append everything written so far to another writer. The data
+	// is written through in chunks, but this writer keeps its position.
+	bool CopyTo( FileWriter& target );
+
+public:
+
+	// accessors
+
+	bool IsOpen() const
+	{
+		return _fp != nullptr;
+	}
+
+	const std::string& GetName() const
+	{
+		return _name;
+	}
+
+	// After Close, true if the file already held exactly what was written.
+	bool IsUnchanged() const
+	{
+		return _bUnchanged;
+	}
+
+	// Size of the file so far, or bytes written if it's a pipe. Flush first.
+	long GetFileSize() const
+	{
+		const long size = _fp ? ftell( _fp ) : -1;
+		return size >= 0 ? size : static_cast< long >( _written );
+	}
+
+
+private:
+
+	// A queued piece. Copies have no pointer, as the buffer may move.
+	struct Piece
+	{
+		const uint8_t* pData;
+		size_t offset;
+		size_t count;
+	};
+
+	FILE* _fp;
+	bool _bError;
+	bool _bUnchanged;
+	size_t _written;
+
+	std::string _name; // What's being written.
+	std::string _partName; // Where it's written until Close. Empty for streams.
+
+	std::vector< uint8_t > _copies;
+	std::vector< Piece > _pieces;
+
+};
@@ -25,24 +25,104 @@ SOFTWARE.
 #include <cstdlib>
 #include <cstring>
 
+#if defined( _WIN32 )
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
 #include "Image.h"
+#include "PixelFormatTraits.h"
+#include "RowKernels.h"
+
+//==============================================================================
+
+// Alignment of the first row.
+static const size_t kImageAlign = 64;
+
+// Buffers smaller than this never use huge pages.
+static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+// Allocate a zeroed buffer of huge pages, rounding up to whole pages. Returns
+// nullptr if the OS won't provide them.
+static void* allocHugePages( size_t& byteCount )
+{
+#if defined( _WIN32 )
+	// ... needs the "Lock pages in memory" privilege, which most users don't have.
+	const size_t pageSize = GetLargePageMinimum();
+	if ( pageSize == 0 )
+	{
+		return nullptr;
+	}
+
+	const size_t size = ( ( byteCount + pageSize - 1 ) / pageSize ) * pageSize;
+	void* p = VirtualAlloc( nullptr, size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE );
+#else
+	const size_t size = ( ( byteCount + kHugePageSize - 1 ) / kHugePageSize ) * kHugePageSize;
+	void* p = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( p == MAP_FAILED )
+	{
+		return nullptr;
+	}
+
+#ifdef MADV_HUGEPAGE
+	// ... only a hint; transparent huge pages may be disabled.
+	madvise( p, size, MADV_HUGEPAGE );
+#endif
+#endif
+
+	if ( p )
+	{
+		byteCount = size;
+	}
+
+	return p;
+}
+
+static void freeHugePages( void* p, size_t byteCount )
+{
+#if defined( _WIN32 )
+	VirtualFree( p, 0, MEM_RELEASE );
+#else
+	munmap( p, byteCount );
+#endif
+}
+
+//==============================================================================
 
 Image::Image() : 
 	
-	_pData( nullptr ),
-
 	_width( 0 ),
-	_height( 0 ),
 	_pitch( 0 ),
-	_stride( 0 )
+	_stride( 0 ),
+	_height( 0 ),
+	_span( 0 ),
+	_byteCount( 0 ),
+
+	_pData( nullptr ),
+	_pAlloc( nullptr ),
+	_bHugePages( false ),
+
+	_packRow( nullptr ),
+	_unpackRow( nullptr ),
+	_maskRow( nullptr ),
+	_shiftRow( nullptr ),
+	_encodeTile8x8( nullptr ),
+	_decodeTile8x8( nullptr )
 
 {
 	//
 }
 
+Image::~Image()
+{
+	Destroy();
+}
+
 void Image::Plot( int x, int y, uint32_t data )
 {
-	uint32_t offset;
+	size_t offset;
 
 	switch ( _pixelFmt )
 	{
@@ -53,7 +133,7 @@ void Image::Plot( int x, int y, uint32_t data )
 	case PixelFormat::PACKED_1:
 	case PixelFormat::AMSTRAD_CPC_M2:
 		{
-			offset = ( x >> 3 ) + y * _pitch;
+			offset = ( x >> 3 ) + static_cast< size_t >( y ) * _span;
 			uint8_t* p = _pData + offset;
 
 			uint8_t mask;
@@ -73,7 +153,7 @@ void Image::Plot( int x, int y, uint32_t data )
 	case PixelFormat::PACKED_2:
 	case PixelFormat::IBM_CGA:
 		{
-			offset = ( x >> 2 ) + y * _pitch;
+			offset = ( x >> 2 ) + static_cast< size_t >( y ) * _span;
 			uint8_t* p = _pData + offset;
 
 			data &= 0x3; // extract 4 colour value
@@ -91,7 +171,7 @@ void Image::Plot( int x, int y, uint32_t data )
 
 	case PixelFormat::PACKED_4:
 		{
-			offset = ( x >> 1 ) + y * _pitch;
+			offset = ( x >> 1 ) + static_cast< size_t >( y ) * _span;
 			uint8_t* p = _pData + offset;
 
 			if ( x & 1 )
@@ -111,14 +191,14 @@ void Image::Plot( int x, int y, uint32_t data )
 	
 	case PixelFormat::CHUNKY_8:
 		{
-			offset = x + y * _pitch;
+			offset = x + static_cast< size_t >( y ) * _span;
 			_pData[ offset ] = static_cast<uint8_t>( data & 0xFF );
 		}
 		break;
 	
 	case PixelFormat::CHUNKY_16:
 		{
-			offset = ( x * 2 ) + y * _pitch;
+			offset = ( x * 2 ) + static_cast< size_t >( y ) * _span;
 			uint16_t* p = reinterpret_cast<uint16_t*>( &( _pData[ offset ] ) );
 			*p = static_cast<uint16_t>( data & 0xFFFF );
 		}
@@ -126,7 +206,7 @@ void Image::Plot( int x, int y, uint32_t data )
 	
 	case PixelFormat::CHUNKY_32:
 		{
-			offset = ( x * 4 ) + y * _pitch;
+			offset = ( x * 4 ) + static_cast< size_t >( y ) * _span;
 			uint32_t* p = reinterpret_cast<uint32_t*>( &( _pData[ offset ] ) );
 			*p = data;
 		}
@@ -134,57 +214,60 @@ void Image::Plot( int x, int y, uint32_t data )
 
 	case PixelFormat::ATART_ST_M0:
 		{
-			// ... select pixel within the 16-pixel plane.
-			uint16_t block = ( x >> 4 );
-			uint16_t mask = 1 << ( x & 0xF );
+			// ... select pixel within the 16-pixel plane. Big-endian, so the
+			// left 8 pixels are in the first byte, MSB = left.
+			int block = ( x >> 4 );
+			uint8_t mask = 0x80 >> ( x & 0x7 );
 
-			// ... offset to first bit-plane
-			offset = ( block * 8 ) + ( y * _pitch );
-			uint16_t* p = reinterpret_cast<uint16_t*>( &( _pData[ offset ] ) );
+			// ... offset to the byte within the first bit-plane (planes are 2 bytes apart)
+			offset = ( block * 8 ) + ( ( x >> 3 ) & 1 ) + ( static_cast< size_t >( y ) * _span );
+			uint8_t* p = &( _pData[ offset ] );
 			
 			// ... set/clear bit planes
 			if ( data & 1 ) { p[ 0 ] |= mask; }			else { p[ 0 ] &= ~mask; }
-			if ( data & 2 ) { p[ 1 ] |= mask; }			else { p[ 1 ] &= ~mask; }
-			if ( data & 4 ) { p[ 2 ] |= mask; }			else { p[ 2 ] &= ~mask; }
-			if ( data & 8 ) { p[ 3 ] |= mask; }			else { p[ 3 ] &= ~mask; }
+			if ( data & 2 ) { p[ 2 ] |= mask; }			else { p[ 2 ] &= ~mask; }
+			if ( data & 4 ) { p[ 4 ] |= mask; }			else { p[ 4 ] &= ~mask; }
+			if ( data & 8 ) { p[ 6 ] |= mask; }			else { p[ 6 ] &= ~mask; }
 		}
 		break;
 
 	case PixelFormat::ATART_ST_M1:
 		{
-			// ... select pixel within the 16-pixel plane.
-			uint16_t block = ( x >> 4 );
-			uint16_t mask = 1 << ( x & 0xF );
-
-			// ... offset to first bit-plane
-			offset = ( block * 4 ) + ( y * _pitch );
-			uint16_t* p = reinterpret_cast<uint16_t*>( &( _pData[ offset ] ) );
+			// ... select pixel within the 16-pixel plane. Big-endian, so the
+			// left 8 pixels are in the first byte, MSB = left.
+			int block = ( x >> 4 );
+			uint8_t mask = 0x80 >> ( x & 0x7 );
 
+			// ... offset to the byte within the first bit-plane (planes are 2 bytes apart)
+			offset = ( block * 4 ) + ( ( x >> 3 ) & 1 ) + ( static_cast< size_t >( y ) * _span );
+			uint8_t* p = &( _pData[ offset ] );
+			
 			// ... set/clear bit planes
 			if ( data & 1 ) { p[ 0 ] |= mask; }			else { p[ 0 ] &= ~mask; }
-			if ( data & 2 ) { p[ 1 ] |= mask; }			else { p[ 1 ] &= ~mask; }
+			if ( data & 2 ) { p[ 2 ] |= mask; }			else { p[ 2 ] &= ~mask; }
 		}
 		break;
 
 	case PixelFormat::ATART_ST_M2:
 		{
-			// ... select pixel within the 16-pixel plane.
-			uint16_t block = ( x >> 4 );
-			uint16_t mask = 1 << ( x & 0xF );
+			// ... select pixel within the 16-pixel plane. Big-endian, so the
+			// left 8 pixels are in the first byte, MSB = left.
+			int block = ( x >> 4 );
+			uint8_t mask = 0x80 >> ( x & 0x7 );
 
-			// ... offset to bit-plane
-			offset = ( block * 2 ) + ( y * _pitch );
-			uint16_t* p = reinterpret_cast<uint16_t*>( &( _pData[ offset ] ) );
+			// ... offset to the byte within the bit-plane
+			offset = ( block * 2 ) + ( ( x >> 3 ) & 1 ) + ( static_cast< size_t >( y ) * _span );
+			uint8_t* p = &( _pData[ offset ] );
 
 			// ... set/clear bit plane
-			if ( data & 1 ) { p[ 0 ] |= mask; }	else { p[ 0 ] &= ~mask; }
+			if ( data & 1 ) { *p |= mask; }	else { *p &= ~mask; }
 		}
 		break;
 
 	case PixelFormat::AMSTRAD_CPC_M0:
 		{
-			uint16_t block = ( x >> 1 );
-			offset = block + ( y * _pitch );
+			int block = ( x >> 1 );
+			offset = block + ( static_cast< size_t >( y ) * _span );
 			uint8_t* p = &( _pData[ offset ] );
 			uint8_t mask;
 
@@ -221,8 +304,8 @@ void Image::Plot( int x, int y, uint32_t data )
 
 	case PixelFormat::AMSTRAD_CPC_M1:
 		{
-			uint16_t block = ( x >> 2 );
-			offset = block + ( y * _pitch );
+			int block = ( x >> 2 );
+			offset = block + ( static_cast< size_t >( y ) * _span );
 			uint8_t* p = &( _pData[ offset ] );
 			
 			uint8_t mask0, mask1;
@@ -241,7 +324,7 @@ void Image::Plot( int x, int y, uint32_t data )
 			uint8_t mask = 0x80 >> ( x & 0x7 );
 
 			// ... offset to first bit-plane
-			offset = ( block * 4 ) + ( y * _pitch );
+			offset = ( block * 4 ) + ( static_cast< size_t >( y ) * _span );
 			uint8_t* p = &( _pData[ offset ] );
 
 			// ... set/clear bit planes
@@ -259,7 +342,7 @@ void Image::Plot( int x, int y, uint32_t data )
 			uint8_t mask = 0x80 >> ( x & 0x7 );
 
 			// ... offset to first bit-plane
-			offset = ( block * 2 ) + ( y * _pitch );
+			offset = ( block * 2 ) + ( static_cast< size_t >( y ) * _span );
 			uint8_t* p = &( _pData[ offset ] );
 
 			// ... set/clear bit planes
@@ -271,10 +354,10 @@ void Image::Plot( int x, int y, uint32_t data )
 	case PixelFormat::NES:
 		{
 			// ... which tile are we in?
-			int tile = ( x >> 3 ) + ( y >> 3 ) * ( _width >> 3 );
+			size_t tile = ( x >> 3 ) + static_cast< size_t >( y >> 3 ) * ( _width >> 3 );
 
 			// ... offset to first bit of tile (tiles are 16 byte chunks)
-			int offset = tile * 16;
+			offset = tile * 16;
 			uint8_t* p = &( _pData[ offset ] );
 
 			// ... select row within tile chunk.
@@ -294,7 +377,7 @@ void Image::Plot( int x, int y, uint32_t data )
 uint32_t Image::Peek( int x, int y ) const
 {
 	uint32_t data = 0;
-	uint32_t offset;
+	size_t offset;
 
 	switch ( _pixelFmt )
 	{
@@ -305,7 +388,7 @@ uint32_t Image::Peek( int x, int y ) const
 	case PixelFormat::PACKED_1:
 	case PixelFormat::AMSTRAD_CPC_M2:
 		{
-			offset = ( x >> 3 ) + y * _pitch;
+			offset = ( x >> 3 ) + static_cast< size_t >( y ) * _span;
 			uint8_t* p = _pData + offset;
 
 			uint8_t mask;
@@ -318,7 +401,7 @@ uint32_t Image::Peek( int x, int y ) const
 	case PixelFormat::PACKED_2:
 	case PixelFormat::IBM_CGA:
 		{
-			offset = ( x >> 2 ) + y * _pitch;
+			offset = ( x >> 2 ) + static_cast< size_t >( y ) * _span;
 			uint8_t* p = _pData + offset;
 
 			uint8_t shift;
@@ -330,7 +413,7 @@ uint32_t Image::Peek( int x, int y ) const
 
 	case PixelFormat::PACKED_4:
 		{
-			offset = ( x >> 1 ) + y * _pitch;
+			offset = ( x >> 1 ) + static_cast< size_t >( y ) * _span;
 			uint8_t* p = _pData + offset;
 
 			if ( x & 1 )
@@ -348,34 +431,161 @@ uint32_t Image::Peek( int x, int y ) const
 
 	case PixelFormat::CHUNKY_8:
 		{
-			offset = x + y * _pitch;
+			offset = x + static_cast< size_t >( y ) * _span;
 			data = _pData[ offset ];
 		}
 		break;
 
 	case PixelFormat::CHUNKY_16:
 		{
-			offset = ( x * 2 ) + y * _pitch;
-			uint16_t* p = reinterpret_cast<uint16_t*>( _pData[ offset ] );
+			offset = ( x * 2 ) + static_cast< size_t >( y ) * _span;
+			uint16_t* p = reinterpret_cast<uint16_t*>( &( _pData[ offset ] ) );
 			data = *p;
 		}
 		break;
 
 	case PixelFormat::CHUNKY_32:
 		{
-			offset = ( x * 4 ) + ( y * _pitch );
+			offset = ( x * 4 ) + ( static_cast< size_t >( y ) * _span );
 			uint32_t* p = reinterpret_cast<uint32_t*>( &( _pData[ offset ] ) );
 			data = *p;
 		}
 		break;
 
-	default:
 	case PixelFormat::ATART_ST_M0:
+		{
+			// ... select pixel within the 16-pixel plane. Big-endian, so the
+			// left 8 pixels are in the first byte, MSB = left.
+			int block = ( x >> 4 );
+			uint8_t mask = 0x80 >> ( x & 0x7 );
+
+			// ... offset to the byte within the first bit-plane (planes are 2 bytes apart)
+			offset = ( block * 8 ) + ( ( x >> 3 ) & 1 ) + ( static_cast< size_t >( y ) * _span );
+			const uint8_t* p = &( _pData[ offset ] );
+
+			// ... gather bit planes
+			data  = ( p[ 0 ] & mask ) ? 1 : 0;
+			data |= ( p[ 2 ] & mask ) ? 2 : 0;
+			data |= ( p[ 4 ] & mask ) ? 4 : 0;
+			data |= ( p[ 6 ] & mask ) ? 8 : 0;
+		}
+		break;
+
 	case PixelFormat::ATART_ST_M1:
+		{
+			// ... select pixel within the 16-pixel plane. Big-endian, so the
+			// left 8 pixels are in the first byte, MSB = left.
+			int block = ( x >> 4 );
+			uint8_t mask = 0x80 >> ( x & 0x7 );
+
+			// ... offset to the byte within the first bit-plane (planes are 2 bytes apart)
+			offset = ( block * 4 ) + ( ( x >> 3 ) & 1 ) + ( static_cast< size_t >( y ) * _span );
+			const uint8_t* p = &( _pData[ offset ] );
+
+			// ... gather bit planes
+			data  = ( p[ 0 ] & mask ) ? 1 : 0;
+			data |= ( p[ 2 ] & mask ) ? 2 : 0;
+		}
+		break;
+
 	case PixelFormat::ATART_ST_M2:
+		{
+			// ... select pixel within the 16-pixel plane. Big-endian, so the
+			// left 8 pixels are in the first byte, MSB = left.
+			int block = ( x >> 4 );
+			uint8_t mask = 0x80 >> ( x & 0x7 );
+
+			// ... offset to the byte within the bit-plane
+			offset = ( block * 2 ) + ( ( x >> 3 ) & 1 ) + ( static_cast< size_t >( y ) * _span );
+
+			data = ( _pData[ offset ] & mask ) ? 1 : 0;
+		}
+		break;
+
 	case PixelFormat::AMSTRAD_CPC_M0:
+		{
+			offset = ( x >> 1 ) + ( static_cast< size_t >( y ) * _span );
+			uint8_t b = _pData[ offset ];
+
+			// ... pixel 1 is one bit lower than pixel 0.
+			if ( x & 1 )
+			{
+				b <<= 1;
+			}
+
+			data  = ( b >> 7 ) & 1; // bit 0
+			data |= ( ( b >> 3 ) & 1 ) << 1; // bit 1
+			data |= ( ( b >> 5 ) & 1 ) << 2; // bit 2
+			data |= ( ( b >> 1 ) & 1 ) << 3; // bit 3
+		}
+		break;
+
 	case PixelFormat::AMSTRAD_CPC_M1:
-		// todo
+		{
+			offset = ( x >> 2 ) + ( static_cast< size_t >( y ) * _span );
+			uint8_t b = _pData[ offset ];
+
+			uint8_t mask0, mask1;
+			mask0 = 0x80 >> ( x & 3 );
+			mask1 = 0x08 >> ( x & 3 );
+
+			data  = ( b & mask0 ) ? 1 : 0;
+			data |= ( b & mask1 ) ? 2 : 0;
+		}
+		break;
+
+	case PixelFormat::MASTER_SYSTEM:
+		{
+			// ... select pixel within the 8-pixel plane.
+			int block = ( x >> 3 );
+			uint8_t mask = 0x80 >> ( x & 0x7 );
+
+			// ... offset to first bit-plane
+			offset = ( block * 4 ) + ( static_cast< size_t >( y ) * _span );
+			const uint8_t* p = &( _pData[ offset ] );
+
+			// ... gather bit planes
+			data  = ( p[ 0 ] & mask ) ? 1 : 0;
+			data |= ( p[ 1 ] & mask ) ? 2 : 0;
+			data |= ( p[ 2 ] & mask ) ? 4 : 0;
+			data |= ( p[ 3 ] & mask ) ? 8 : 0;
+		}
+		break;
+
+	case PixelFormat::GAMEBOY:
+		{
+			// ... select pixel within the 8-pixel plane.
+			int block = ( x >> 3 );
+			uint8_t mask = 0x80 >> ( x & 0x7 );
+
+			// ... offset to first bit-plane
+			offset = ( block * 2 ) + ( static_cast< size_t >( y ) * _span );
+			const uint8_t* p = &( _pData[ offset ] );
+
+			// ... gather bit planes
+			data  = ( p[ 0 ] & mask ) ? 1 : 0;
+			data |= ( p[ 1 ] & mask ) ? 2 : 0;
+		}
+		break;
+
+	case PixelFormat::NES:
+		{
+			// ... which tile are we in?
+			size_t tile = ( x >> 3 ) + static_cast< size_t >( y >> 3 ) * ( _width >> 3 );
+
+			// ... offset to first bit of tile (tiles are 16 byte chunks)
+			offset = tile * 16;
+			const uint8_t* p = &( _pData[ offset ] );
+
+			// ... select row within tile chunk.
+			int row = ( y & 7 );
+
+			uint8_t mask = 0x80 >> ( x & 0x7 );
+
+			// ... gather bit planes
+			data  = ( p[ row ] & mask ) ? 1 : 0;
+			data |= ( p[ 8 + row ] & mask ) ? 2 : 0;
+		}
 		break;
 
 	}
@@ -387,128 +597,170 @@ void Image::Clear( uint8_t value )
 {
 	if ( _pData )
 	{
-		uint32_t byteCount = _pitch * _height;
-		memset( _pData, value, byteCount );
+		memset( _pData, value, _span * _height );
 	}
 }
 
-void Image::Create( PixelFormat fmt, uint16_t width, uint16_t height )
+void Image::PackRow( int y, const uint8_t* pSrc8 )
 {
-	free( _pData ); // clear any leaks.
-	_pData = nullptr;
+	if ( _packRow )
+	{
+		_packRow( pSrc8, _stride, _pData + RowOffset( y ) );
+	}
+}
 
-	_pixelFmt = fmt;
+void Image::UnpackRow( int y, uint8_t* pDst8 ) const
+{
+	if ( _unpackRow )
+	{
+		_unpackRow( _pData + RowOffset( y ), _stride, pDst8 );
+	}
+}
 
-	if ( fmt == PixelFormat::UNKNOWN )
+void Image::MaskRow( int y, const uint8_t* pSrc8, const IndexSet& set, bool bInvert )
+{
+	if ( _maskRow )
 	{
-		_width = 0;
-		_height = 0;
-		return;
+		_maskRow( pSrc8, _width, set, bInvert, _pData + RowOffset( y ) );
 	}
+}
 
-	_width = width;
-	_height = height;
+void Image::ShiftRow( int y, const uint8_t* pSrc, int count, int shift, const uint8_t* pFill )
+{
+	if ( _shiftRow )
+	{
+		_shiftRow( pSrc, count, shift, pFill, _pData + RowOffset( y ) );
+	}
+}
 
-	switch ( fmt )
+void Image::PackTile8x8( int y, const ImageView& src )
+{
+	if ( _encodeTile8x8 )
 	{
-	
-	case PixelFormat::PACKED_1:
-	case PixelFormat::AMSTRAD_CPC_M2:
-		_pitch = ( width + 7 ) / 8;
-		_stride = _pitch * 8;
-		break;
-	
-	case PixelFormat::PACKED_4:
-		_pitch = ( width + 1 ) / 2;
-		_stride = _pitch * 2;
-		break;
-	
-	case PixelFormat::CHUNKY_8:
-		_pitch = width;
-		_stride = width;
-		break;
-	
-	case PixelFormat::CHUNKY_16:
-		_pitch = width * 2;
-		_stride = width;
-		break;
-	
-	case PixelFormat::CHUNKY_32:
-		_pitch = width * 4;
-		_stride = width;
-		break;
+		// One tile wide, so each pattern is contiguous.
+		_encodeTile8x8( src.GetRowPtr( 0 ), static_cast< int >( src.GetSpan() ), _pData + RowOffset( y ) );
+	}
+}
 
-	case PixelFormat::ATART_ST_M0:
-		_pitch = ( ( width + 15 ) / 16 ) * 8;
-		_stride = _pitch * 2;
-		break;
+void Image::UnpackTile8x8( int y, uint8_t* pDst8, int dstPitch ) const
+{
+	if ( _decodeTile8x8 )
+	{
+		// One tile wide, so each pattern is contiguous.
+		_decodeTile8x8( _pData + RowOffset( y ), pDst8, dstPitch );
+	}
+}
 
-	case PixelFormat::ATART_ST_M1:
-		_pitch = ( ( width + 15 ) / 16 ) * 4;
-		_stride = _pitch * 2;
-		break;
+size_t Image::RowOffset( uint32_t y ) const
+{
+	if ( _pixelFmt == PixelFormat::NES )
+	{
+		// ... first tile of the tile row, then select row within tile chunk.
+		return static_cast< size_t >( y >> 3 ) * ( _width >> 3 ) * 16 + ( y & 7 );
+	}
+	else
+	{
+		return static_cast< size_t >( y ) * _span;
+	}
+}
 
-	case PixelFormat::ATART_ST_M2:
-		_pitch = ( ( width + 15 ) / 16 ) * 2;
-		_stride = _pitch * 2;
-		break;
+void Image::Create( PixelFormat fmt, uint32_t width, uint32_t height, const ImageLayout& layout )
+{
+	Destroy(); // clear any leaks.
 
-	case PixelFormat::AMSTRAD_CPC_M0:
-		_pitch = ( width + 1 ) / 2;
-		_stride = _pitch * 2;
-		break;
+	_pixelFmt = fmt;
 
-	case PixelFormat::AMSTRAD_CPC_M1:
-		_pitch = ( width + 3 ) / 4;
-		_stride = _pitch * 4;
-		break;
+	// Bind the row kernels once per image.
+	_packRow = GetPackRowKernel( fmt );
+	_unpackRow = GetUnpackRowKernel( fmt );
+	_maskRow = GetMaskRowKernel( fmt );
+	_shiftRow = GetShiftRowKernel( fmt );
+	_encodeTile8x8 = GetEncodeTile8x8Kernel( fmt );
+	_decodeTile8x8 = GetDecodeTile8x8Kernel( fmt );
 
-	case PixelFormat::IBM_CGA:
-		_pitch = ( width + 3 ) / 4;
-		_stride = _pitch * 4;
-		break;
+	if ( fmt == PixelFormat::UNKNOWN )
+	{
+		_width = 0;
+		_height = 0;
+		return;
+	}
 
-	case PixelFormat::GAMEBOY:
-		_pitch = ( ( width + 7 ) / 8 ) * 2;
-		_stride = _pitch * 4;
-		_height = ( ( height + 7 ) / 8 ) * 8; // ensure 8 pixel lines
-		break;
+	bool bPackedRows = false;
 
-	case PixelFormat::MASTER_SYSTEM:
-		_pitch = ( ( width + 7 ) / 8 ) * 4;
-		_stride = _pitch * 2;
-		_height = ( ( height + 7 ) / 8 ) * 8; // ensure 8 pixel lines
-		break;
+	DispatchPixelFormat( fmt, [ & ]( auto traits )
+	{
+		typedef decltype( traits ) Traits;
 
-	case PixelFormat::NES: // treat each tile as 16 x 1 => 2 * 8
-		_width = ( ( width + 7 ) / 8 ) * 8; // ensure 8 pixel columns
-		_pitch = _width >> 2;
-		_stride = _pitch >> 1;
-		_height = ( ( height + 7 ) / 8 ) * 8; // ensure 8 pixel lines
-		break;
+		// ... pattern formats are whole 8x8 tiles high. Tile-linear formats need
+		// whole tiles across too, since rows don't have their own storage.
+		_width = Traits::kTileLinear ? Traits::AlignW( width ) : width;
+		_height = Traits::AlignH( height );
+		_pitch = Traits::Pitch( _width );
+		_stride = Traits::Stride( _pitch );
+
+		// ... tile kernels write whole patterns, so rows must be back to back.
+		bPackedRows = Traits::kIsPattern8x8 || Traits::kTileLinear;
+	} );
 
+	if ( bPackedRows )
+	{
+		_span = _pitch;
+	}
+	else
+	{
+		const size_t align = layout.rowAlign ? layout.rowAlign : 1;
+		_span = ( ( static_cast< size_t >( _pitch ) + layout.rowPadding + align - 1 ) / align ) * align;
 	}
 
-	uint32_t uByteCount;
-	uByteCount = _pitch * _height;
+	_byteCount = _span * _height;
 
-	_pData = reinterpret_cast< uint8_t* >( calloc( _height, _pitch ) );
+	if ( layout.bHugePages && _byteCount >= kHugePageSize )
+	{
+		// ... page aligned, and already zero.
+		_pAlloc = allocHugePages( _byteCount );
+		_bHugePages = ( _pAlloc != nullptr );
+		_pData = reinterpret_cast< uint8_t* >( _pAlloc );
+	}
+
+	if ( _pAlloc == nullptr )
+	{
+		// calloc leaves big buffers to the OS to zero lazily, so align by hand.
+		_pAlloc = calloc( _byteCount + kImageAlign - 1, 1 );
+		if ( _pAlloc )
+		{
+			const uintptr_t addr = reinterpret_cast< uintptr_t >( _pAlloc );
+			_pData = reinterpret_cast< uint8_t* >( ( addr + kImageAlign - 1 ) & ~( kImageAlign - 1 ) );
+		}
+	}
 }
 
 void Image::Destroy()
 {
-	free( _pData );
+	if ( _bHugePages )
+	{
+		freeHugePages( _pAlloc, _byteCount );
+	}
+	else
+	{
+		free( _pAlloc );
+	}
+
+	_pAlloc = nullptr;
 	_pData = nullptr;
+	_bHugePages = false;
+	_byteCount = 0;
+}
+
+const uint8_t* Image::GetRowPtr( uint32_t row ) const
+{
+	return const_cast< Image* >( this )->GetRowPtr( row );
 }
 
-uint8_t* Image::GetRowPtr( uint16_t row )
+uint8_t* Image::GetRowPtr( uint32_t row )
 {
 	if ( _pData && ( row < _height ) )
 	{
-		uint32_t offset;
-		offset = row * _pitch;
-
-		return _pData + offset;
+		return _pData + static_cast< size_t >( row ) * _span;
 	}
 	else
 	{
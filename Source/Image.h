@@ -24,9 +24,26 @@ SOFTWARE.
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include "PixelFormat.h"
+#include "RowKernels.h"
+#include "ImageView.h"
+
+// Row layout options for Image::Create.
+struct ImageLayout
+{
+	// Alignment of each row in bytes, a power of two. 1 = rows packed end to end.
+	// The buffer itself is always 64-byte aligned.
+	uint32_t rowAlign = 64;
+
+	// Minimum spare bytes after each row, so SIMD kernels can over-read and over-write.
+	uint32_t rowPadding = 0;
+
+	// Back large buffers with huge pages, where the OS allows it.
+	bool bHugePages = false;
+};
 
 // Bitmap container.
 
@@ -47,14 +64,49 @@ public:
 	// Clear all bytes to a specific value.
 	void Clear( uint8_t value );
 
+	// Pack a row of CHUNKY_8 indices into row y. pSrc8 must hold GetStride() indices.
+	// WARNING: No checks are made on the Y position being within range!
+	void PackRow( int y, const uint8_t* pSrc8 );
+
+	// Unpack row y into GetStride() CHUNKY_8 indices.
+	// WARNING: No checks are made on the Y position being within range!
+	void UnpackRow( int y, uint8_t* pDst8 ) const;
+
+	// Test GetWidth() CHUNKY_8 indices for membership of 'set' and pack the mask into
+	// row y, as for fnMaskRow. The padding up to GetStride() is masked as index zero.
+	// WARNING: No checks are made on the Y position being within range!
+	void MaskRow( int y, const uint8_t* pSrc8, const IndexSet& set, bool bInvert );
+
+	// Write a packed row of 'count' pixels into row y, shifted right by 'shift' pixels,
+	// as for fnShiftRow. count + shift must be GetWidth().
+	// WARNING: No checks are made on the Y position being within range!
+	void ShiftRow( int y, const uint8_t* pSrc, int count, int shift, const uint8_t* pFill );
+
+	// Pack an 8x8 view of CHUNKY_8 indices into rows y to y+7, for pattern formats
+	// (see PixelFormatIsPattern8x8).
+	// WARNING: The image must be 8 pixels wide and y a multiple of 8!
+	void PackTile8x8( int y, const ImageView& src );
+
+	// Unpack rows y to y+7 of a pattern format into an 8x8 block of CHUNKY_8 indices,
+	// with rows dstPitch bytes apart.
+	// WARNING: The image must be 8 pixels wide and y a multiple of 8!
+	void UnpackTile8x8( int y, uint8_t* pDst8, int dstPitch ) const;
+
 
 public:
 
 	// Default constructor.
 	Image();
 
-	// Create a new image with a size and pixel format.
-	void Create( PixelFormat fmt, uint16_t width, uint16_t height );
+	~Image();
+
+	// Images own their data, so can't be copied.
+	Image( const Image& ) = delete;
+	Image& operator=( const Image& ) = delete;
+
+	// Create a new image with a size and pixel format. The data is cleared to zero.
+	// Pattern and tile-linear formats ignore the layout's row alignment and padding.
+	void Create( PixelFormat fmt, uint32_t width, uint32_t height, const ImageLayout& layout = ImageLayout() );
 	
 	// Free data and tidy up.
 	void Destroy();
@@ -65,43 +117,76 @@ public:
 	//
 	// -- accessors
 
-	uint8_t* GetRowPtr( uint16_t row );
+	uint8_t* GetRowPtr( uint32_t row );
+
+	const uint8_t* GetRowPtr( uint32_t row ) const;
 
 	PixelFormat GetPixelFormat() const
 	{
 		return _pixelFmt;
 	}
 
-	uint16_t GetWidth() const
+	uint32_t GetWidth() const
 	{
 		return _width;
 	}
 
-	uint16_t GetPitch() const
+	uint32_t GetPitch() const
 	{
 		return _pitch;
 	}
 
-	uint16_t GetStride() const
+	uint32_t GetStride() const
 	{
 		return _stride;
 	}
 
-	uint16_t GetHeight() const
+	uint32_t GetHeight() const
 	{
 		return _height;
 	}
 
+	// Bytes from the start of one row to the next. At least GetPitch().
+	size_t GetSpan() const
+	{
+		return _span;
+	}
+
+	// Total bytes allocated.
+	size_t GetByteCount() const
+	{
+		return _byteCount;
+	}
+
+
+private:
+
+	// Byte offset to the first byte of a row.
+	size_t RowOffset( uint32_t y ) const;
+
 
 private:
 
-	uint16_t _width; // pixels per row
-	uint16_t _pitch; // bytes per row
-	uint16_t _stride; // pixels per pitch
-	uint16_t _height;
+	uint32_t _width; // pixels per row
+	uint32_t _pitch; // bytes per row
+	uint32_t _stride; // pixels per pitch
+	uint32_t _height;
+
+	size_t _span; // bytes between rows in memory
+	size_t _byteCount; // bytes allocated
 
 	PixelFormat _pixelFmt;
 
-	uint8_t* _pData;
+	uint8_t* _pData; // first row, 64-byte aligned
+	void* _pAlloc; // allocation containing _pData
+	bool _bHugePages; // _pAlloc is a huge page mapping
+
+	// Row kernels for _pixelFmt, bound by Create.
+	fnPackRow _packRow;
+	fnUnpackRow _unpackRow;
+	fnMaskRow _maskRow;
+	fnShiftRow _shiftRow;
+	fnEncodeTile8x8 _encodeTile8x8;
+	fnDecodeTile8x8 _decodeTile8x8;
 
 };
\ No newline at end of file
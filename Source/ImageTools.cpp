@@ -26,6 +26,8 @@ SOFTWARE.
 #include <cstring>
 
 #include "utils.h"
+#include "CpuFeatures.h"
+#include "RowKernels.h"
 
 
 //------------------------------------------------------------------------------
@@ -47,6 +49,7 @@ struct Tool
 extern int Help( int argc, char** argv );
 extern int Export( int argc, char** argv );
 extern int Mask( int argc, char** argv );
+extern int Sprite( int argc, char** argv );
 
 #define HELP_BLOCK_HEADER																	\
 		"  -H###        Add a header. ### is a string of codes as follows:\n\n"				\
@@ -85,17 +88,24 @@ static Tool gTools[] =
 	//-----------------
 
 	{
-		"export", Export, "Export a raw image in a new pixel format.", "<input> <output> [-tile WxH] [-shift R] [-append]\n\t[-2x] [-H###] [-pf format]",
-		"  <input>      An image file to read. (Indexed .PNG only)\n\n"
-		"  <output>     The output file.\n\n"
+		"export", Export, "Export a raw image in a new pixel format.", "<input> <output> [-tile WxH] [-shift R]\n\t[-shifts S,T-U] [-allshifts] [-append] [-maxmem N] [-2x]\n\t[-scale NxM] [-H###] [-pf format]",
+		"  <input>      An image file to read. (Indexed .PNG only) - for stdin.\n\n"
+		"  <output>     The output file, only replaced once complete and changed. - for stdout, with messages on stderr.\n\n"
 		"  -tile WxH    Split the input image into tiles of WxH pixels and output as\n"
 		"               concatenated chunks. Tiles are split in row-major order.\n\n"
 		
 		"  -shift R     Shift output to the right by R pixels.\n"
 		"               Not supported by GB, NES or SEGA pixel formats.\n"
+		"  -shifts S    Output one copy per shift, e.g. 0-7. Copies are concatenated\n"
+		"               in order, each as if written by -append.\n"
+		"  -allshifts   Output every shift within one byte/word of the pixel format.\n"
 		"  -append      Append to the output file, rather than overwriting it.\n"
+		"  -maxmem N    Work within about N bytes, e.g. 64MB, by processing the image\n"
+		"               in bands of whole tile rows. Extra shifts wait on disk.\n"
 		"  -2x          Double the width of the input image before exporting.\n"
-		"               Not supported by GB, NES or SEGA pixel formats.\n\n"
+		"  -scale NxM   Scale the input image by N across and M down before\n"
+		"               exporting, by repeating pixels. e.g. 4x1 for CPC mode 0.\n"
+		"               -2x and -scale are not supported by GB, NES or SEGA pixel formats.\n\n"
 
 		HELP_BLOCK_HEADER
 
@@ -105,19 +115,27 @@ static Tool gTools[] =
 	},
 
 	{
-		"mask", Mask, "Extract a bit mask from an image.", "<input> <output> [-tile WxH] [-index I] [-not]\n\t[-shift R] [-append] [-2x] [-H###] [-pf format]",
-		"  <input>      An image file to read. (Indexed .PNG only)\n\n"
-		"  <output>     The output file.\n\n"
+		"mask", Mask, "Extract a bit mask from an image.", "<input> <output> [-tile WxH] [-index I,J-K] [-not]\n\t[-shift R] [-shifts S,T-U] [-allshifts] [-append] [-maxmem N] [-2x]\n\t[-scale NxM] [-H###] [-pf format]",
+		"  <input>      An image file to read. (Indexed .PNG only) - for stdin.\n\n"
+		"  <output>     The output file, only replaced once complete and changed. - for stdout, with messages on stderr.\n\n"
 		"  -tile WxH    Split the input image into tiles of WxH pixels and output as\n"
 		"               concatenated chunks. Tiles are split in row-major order.\n\n"
 		
 		"  -index I     Specify the index of pixels to extract. Default 0.\n"
+		"               May be a list of indices and ranges, e.g. 0,3,7-9.\n"
 		"  -not         Invert the output. Including border/shifted area.\n"
 		"  -shift R     Shift output to the right by R pixels.\n"
 		"               Not supported by GB, NES or SEGA pixel formats.\n"
+		"  -shifts S    Output one copy per shift, e.g. 0-7. Copies are concatenated\n"
+		"               in order, each as if written by -append.\n"
+		"  -allshifts   Output every shift within one byte/word of the pixel format.\n"
 		"  -append      Append to the output file, rather than overwriting it.\n"
+		"  -maxmem N    Work within about N bytes, e.g. 64MB, by processing the image\n"
+		"               in bands of whole tile rows. Extra shifts wait on disk.\n"
 		"  -2x          Double the width of the input image.\n"
-		"               Not supported by GB, NES or SEGA pixel formats.\n\n"
+		"  -scale NxM   Scale the input image by N across and M down, by repeating\n"
+		"               pixels.\n"
+		"               -2x and -scale are not supported by GB, NES or SEGA pixel formats.\n\n"
 
 		HELP_BLOCK_HEADER
 
@@ -125,6 +143,40 @@ static Tool gTools[] =
 
 		HELP_BLOCK_PIXEL_FORMAT
 	},
+
+	{
+		"sprite", Sprite, "Export a sprite with its mask interleaved.", "<input> <output> [-tile WxH] [-index I,J-K] [-not]\n\t[-interleave mode] [-shift R] [-shifts S,T-U] [-allshifts] [-append] [-2x]\n\t[-scale NxM] [-H###] [-pf format]",
+		"  <input>      An image file to read. (Indexed .PNG only) - for stdin.\n\n"
+		"  <output>     The output file, only replaced once complete and changed. - for stdout, with messages on stderr.\n\n"
+		"  -tile WxH    Split the input image into tiles of WxH pixels and output as\n"
+		"               concatenated chunks. Tiles are split in row-major order.\n\n"
+		
+		"  -index I     Specify the index of pixels to mask. Default 0.\n"
+		"               May be a list of indices and ranges, e.g. 0,3,7-9.\n"
+		"  -not         Invert the mask. Including border/shifted area.\n"
+		"  -interleave  How to interleave the mask and the pixel data:\n\n"
+		"    byte       Mask byte, data byte, ... (default)\n"
+		"    word       Mask word, data word, ...\n"
+		"    row        Mask row, data row, ...\n"
+		"    plane      One mask plane, then each data plane. e.g. ST0 has one\n"
+		"               mask word then four data words per 16 pixels.\n\n"
+		"  -shift R     Shift output to the right by R pixels.\n"
+		"  -shifts S    Output one copy per shift, e.g. 0-7. Copies are concatenated\n"
+		"               in order, each as if written by -append.\n"
+		"  -allshifts   Output every shift within one byte/word of the pixel format.\n"
+		"  -append      Append to the output file, rather than overwriting it.\n"
+		"  -2x          Double the width of the input image.\n"
+		"  -scale NxM   Scale the input image by N across and M down, by repeating\n"
+		"               pixels.\n\n"
+
+		HELP_BLOCK_HEADER
+
+		"\n"
+
+		HELP_BLOCK_PIXEL_FORMAT
+
+		"\n  GB, NES and SMS are not supported.\n"
+	},
 };
 
 // ... how many tools?
@@ -160,6 +212,46 @@ static int findTool( const char* pName )
 	return -1;
 }
 
+// Handle options that apply to every tool, and remove them from the argument list.
+static int parseGlobalOptions( int& argc, char** argv )
+{
+	int iOut = 1;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		const char* pArg = argv[ i ];
+
+		if ( _stricmp( pArg, "-cpu" ) == 0 )
+		{
+			CpuLevel level;
+
+			if ( i + 1 >= argc || DecodeCpuLevel( argv[ i + 1 ], level ) == false )
+			{
+				// error.
+				PrintError( "Invalid -cpu parameter \"%s\".", ( i + 1 < argc ) ? argv[ i + 1 ] : "" );
+				return 1;
+			}
+
+			if ( LimitCpuFeatures( level ) == false )
+			{
+				Info( "WARNING: This CPU doesn't support %s kernels. Using the best available.\n", CpuLevelToString( level ) );
+			}
+
+			// ... rebind with the new limit.
+			BindRowKernels();
+
+			++i; // skip value
+		}
+		else
+		{
+			argv[ iOut++ ] = argv[ i ];
+		}
+	}
+
+	argc = iOut;
+	return 0;
+}
+
 static void printHello()
 {
 	printf( "\n------------------------------------------------------------------\n"
@@ -171,11 +263,15 @@ static void printHello()
 static void printUsage()
 {
 	// Usage
-	printf( "USAGE: ImageTools tool [args ...]\n\n" );
+	printf( "USAGE: ImageTools tool [args ...] [-cpu level]\n\n" );
 
 	// Files
 	printf( "Specify the tool to use followed by its arguments.\n\n" );
 
+	// Global options
+	printf( "  -cpu LEVEL   Limit the conversion kernels to SCALAR, SSE2, AVX2 or AVX512.\n"
+			"               Default is the best the CPU supports.\n\n" );
+
 	for ( int i = 0; i < gToolsCount; ++i )
 	{
 		// Alias the tool
@@ -242,7 +338,11 @@ int main( int argc, char** argv )
 	PrintRuler( 80 );
 #endif // _DEBUG
 
-	if ( argc < 2 )
+	if ( parseGlobalOptions( argc, argv ) )
+	{
+		iReturnCode = 1;
+	}
+	else if ( argc < 2 )
 	{
 		printHello();
 		printUsage();
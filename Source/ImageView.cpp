@@ -0,0 +1,110 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "ImageView.h"
+#include "Image.h"
+#include "ImageInfo.h"
+#include "PixelFormatTraits.h"
+
+ImageView::ImageView() :
+
+	_pData( nullptr ),
+	_span( 0 ),
+
+	_width( 0 ),
+	_height( 0 ),
+
+	_pixelFmt( PixelFormat::UNKNOWN )
+
+{
+	//
+}
+
+ImageView::ImageView( const uint8_t* pData, size_t span, uint32_t width, uint32_t height, PixelFormat fmt ) :
+
+	_pData( pData ),
+	_span( span ),
+
+	_width( width ),
+	_height( height ),
+
+	_pixelFmt( fmt )
+
+{
+	//
+}
+
+ImageView::ImageView( const Image& image ) :
+
+	_pData( image.GetRowPtr( 0 ) ),
+	_span( image.GetSpan() ),
+
+	_width( image.GetWidth() ),
+	_height( image.GetHeight() ),
+
+	_pixelFmt( image.GetPixelFormat() )
+
+{
+	//
+}
+
+ImageView ImageView::SubView( uint32_t x, uint32_t y, uint32_t width, uint32_t height ) const
+{
+	return DispatchPixelFormat( _pixelFmt, [ & ]( auto traits )
+	{
+		typedef decltype( traits ) Traits;
+
+		if ( _pData == nullptr || Traits::kTileLinear )
+		{
+			return ImageView();
+		}
+
+		// ... x is in whole units, so its byte offset is just the pitch up to it.
+		return ImageView( GetRowPtr( y ) + Traits::Pitch( x ), _span, width, height, _pixelFmt );
+	} );
+}
+
+TileGrid::TileGrid( const Image& image, const ImageInfo& imageInfo, int iTileW, int iTileH )
+{
+	if ( iTileW )
+	{
+		//
+		// -- TILE MODE
+
+		this->iTileW = iTileW;
+		this->iTileH = iTileH;
+		iTilesX = image.GetWidth() / iTileW;
+		iTilesY = image.GetHeight() / iTileH;
+	}
+	else
+	{
+		//
+		// -- WHOLE IMAGE (one big tile)
+
+		this->iTileW = imageInfo.width;
+		this->iTileH = imageInfo.height;
+		iTilesX = 1;
+		iTilesY = 1;
+	}
+}
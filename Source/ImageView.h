@@ -0,0 +1,149 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "PixelFormat.h"
+
+class Image;
+struct ImageInfo;
+
+// Non-owning view of a rectangle of pixels.
+//
+// Views are cheap to copy and never allocate, so tiles can be addressed in place.
+// The viewed data must outlive the view. A view is read-only, so any number of
+// workers may share the same source.
+
+class ImageView
+{
+
+
+public:
+
+	// Empty view.
+	ImageView();
+
+	// View of raw rows, 'span' bytes apart.
+	ImageView( const uint8_t* pData, size_t span, uint32_t width, uint32_t height, PixelFormat fmt );
+
+	// View of a whole image.
+	explicit ImageView( const Image& image );
+
+	// View of a rectangle within this view. For packed formats x must be a multiple
+	// of the pixels per byte (or block). Tile-linear formats can't be split, and
+	// return an empty view.
+	// WARNING: No checks are made on the rectangle being within range!
+	ImageView SubView( uint32_t x, uint32_t y, uint32_t width, uint32_t height ) const;
+
+
+public:
+
+	//
+	// -- accessors
+
+	const uint8_t* GetRowPtr( uint32_t row ) const
+	{
+		return _pData + static_cast< size_t >( row ) * _span;
+	}
+
+	bool IsEmpty() const
+	{
+		return _pData == nullptr;
+	}
+
+	PixelFormat GetPixelFormat() const
+	{
+		return _pixelFmt;
+	}
+
+	uint32_t GetWidth() const
+	{
+		return _width;
+	}
+
+	uint32_t GetHeight() const
+	{
+		return _height;
+	}
+
+	// Bytes from the start of one row to the next.
+	size_t GetSpan() const
+	{
+		return _span;
+	}
+
+
+private:
+
+	const uint8_t* _pData;
+	size_t _span;
+
+	uint32_t _width;
+	uint32_t _height;
+
+	PixelFormat _pixelFmt;
+
+};
+
+
+// How an image is cut into tiles, in row-major order. With no tile width the
+// whole image is one tile.
+struct TileGrid
+{
+	int iTileW;
+	int iTileH;
+	int iTilesX;
+	int iTilesY;
+
+	TileGrid( const Image& image, const ImageInfo& imageInfo, int iTileW, int iTileH );
+
+	// Rows of output, with the tiles stacked one above another.
+	int GetRows() const
+	{
+		return iTileH * iTilesX * iTilesY;
+	}
+};
+
+// Call fn( tile, dst_y0 ) for each tile of 'source', viewed in place. dst_y0 is
+// the tile's first row once the tiles are stacked.
+template< typename FN >
+void ForEachTile( const ImageView& source, const TileGrid& grid, FN fn )
+{
+	for ( int ity = 0; ity < grid.iTilesY; ++ity )
+	{
+		for ( int itx = 0; itx < grid.iTilesX; ++itx )
+		{
+			const ImageView tile = source.SubView( itx * grid.iTileW, ity * grid.iTileH, grid.iTileW, grid.iTileH );
+
+			// output position
+			const int index = itx + ity * grid.iTilesX;
+			fn( tile, index * grid.iTileH );
+
+		}; // for each source column
+
+	}; // for each source row
+}
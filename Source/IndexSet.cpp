@@ -0,0 +1,162 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "IndexSet.h"
+
+IndexSet::IndexSet() :
+
+	_rangeCount( 0 )
+
+{
+	memset( _bitmap, 0, sizeof( _bitmap ) );
+}
+
+IndexSet::IndexSet( uint8_t index ) : IndexSet()
+{
+	Add( index, index );
+}
+
+void IndexSet::Add( uint8_t lo, uint8_t hi )
+{
+	for ( int i = lo; i <= hi; ++i )
+	{
+		_bitmap[ i >> 3 ] |= 1 << ( i & 7 );
+	}
+
+	UpdateRanges();
+}
+
+void IndexSet::Clear()
+{
+	memset( _bitmap, 0, sizeof( _bitmap ) );
+	_rangeCount = 0;
+}
+
+void IndexSet::UpdateRanges()
+{
+	_rangeCount = 0;
+
+	for ( int i = 0; i < 256; ++i )
+	{
+		if ( Contains( static_cast< uint8_t >( i ) ) == false )
+		{
+			continue;
+		}
+
+		// ... start a new range, or extend the last one.
+		if ( _rangeCount && _rangeHi[ _rangeCount - 1 ] == i - 1 )
+		{
+			_rangeHi[ _rangeCount - 1 ] = static_cast< uint8_t >( i );
+		}
+		else
+		{
+			_rangeLo[ _rangeCount ] = static_cast< uint8_t >( i );
+			_rangeHi[ _rangeCount ] = static_cast< uint8_t >( i );
+			++_rangeCount;
+		}
+	}
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// DecodeIndexSet
+//------------------------------------------------------------------------------
+bool DecodeIndexSet( const char* pStr, IndexSet& set )
+{
+	set.Clear();
+
+	for ( ;; )
+	{
+		char* pEnd = nullptr;
+		long lo = strtol( pStr, &pEnd, 10 );
+		long hi = lo;
+
+		if ( pEnd == pStr )
+		{
+			return false; // no number.
+		}
+
+		if ( *pEnd == '-' )
+		{
+			pStr = pEnd + 1;
+			hi = strtol( pStr, &pEnd, 10 );
+
+			if ( pEnd == pStr )
+			{
+				return false; // no number.
+			}
+		}
+
+		if ( lo < 0 || hi > UINT8_MAX || lo > hi )
+		{
+			return false;
+		}
+
+		set.Add( static_cast< uint8_t >( lo ), static_cast< uint8_t >( hi ) );
+
+		if ( *pEnd == 0 )
+		{
+			return true;
+		}
+		else if ( *pEnd != ',' )
+		{
+			return false;
+		}
+
+		pStr = pEnd + 1;
+	}
+}
+
+//------------------------------------------------------------------------------
+// IndexSetToString
+//------------------------------------------------------------------------------
+std::string IndexSetToString( const IndexSet& set )
+{
+	std::string str;
+
+	for ( int r = 0; r < set.GetRangeCount(); ++r )
+	{
+		if ( r )
+		{
+			str += ",";
+		}
+
+		const int lo = set.GetRangeLo( r );
+		const int hi = set.GetRangeHi( r );
+
+		str += std::to_string( lo );
+		if ( hi != lo )
+		{
+			str += "-" + std::to_string( hi );
+		}
+	}
+
+	return str;
+}
+
+//==============================================================================
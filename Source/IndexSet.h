@@ -0,0 +1,110 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// A set of palette indices, held as a 256-bit membership bitmap.
+//
+// The set also keeps its members as a list of inclusive ranges, for kernels that
+// test membership with compares instead of a table lookup.
+
+class IndexSet
+{
+
+
+public:
+
+	// Empty set.
+	IndexSet();
+
+	// Set of one index.
+	explicit IndexSet( uint8_t index );
+
+	// Add the indices lo to hi, inclusive.
+	void Add( uint8_t lo, uint8_t hi );
+
+	// Remove all indices.
+	void Clear();
+
+
+public:
+
+	//
+	// -- accessors
+
+	bool Contains( uint8_t index ) const
+	{
+		return ( _bitmap[ index >> 3 ] >> ( index & 7 ) ) & 1;
+	}
+
+	bool IsEmpty() const
+	{
+		return _rangeCount == 0;
+	}
+
+	// 32 bytes. Index i is bit (i & 7) of byte (i >> 3).
+	const uint8_t* GetBitmap() const
+	{
+		return _bitmap;
+	}
+
+	// Members as sorted, non-adjacent ranges.
+	int GetRangeCount() const
+	{
+		return _rangeCount;
+	}
+
+	uint8_t GetRangeLo( int range ) const
+	{
+		return _rangeLo[ range ];
+	}
+
+	uint8_t GetRangeHi( int range ) const
+	{
+		return _rangeHi[ range ];
+	}
+
+
+private:
+
+	// Rebuild the ranges from the bitmap.
+	void UpdateRanges();
+
+	uint8_t _bitmap[ 32 ];
+
+	int _rangeCount;
+	uint8_t _rangeLo[ 128 ];
+	uint8_t _rangeHi[ 128 ];
+
+};
+
+// Decode a list of indices and ranges, e.g. "0,3,7-9". Returns false if it's invalid,
+// or any index is over 255.
+bool DecodeIndexSet( const char* pStr, IndexSet& set );
+
+// Describe a set in the same form DecodeIndexSet reads.
+std::string IndexSetToString( const IndexSet& set );
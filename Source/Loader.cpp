@@ -22,22 +22,34 @@ SOFTWARE.
 
 */
 
+#include <cstring>
+
 #include "Loader.h"
 #include "ImageInfo.h"
 #include "Image.h"
 
 #include "cPNG.h"
+#include "FileReader.h"
+#include "RowKernels.h"
 
 //==============================================================================
 
-Loader::Loader()
+Loader::Loader() :
+
+	m_p_rows_info( nullptr ),
+	m_rows_width( 0 ),
+	m_rows_height( 0 ),
+	m_rows_scale_x( 1 ),
+	m_rows_scale_y( 1 ),
+	m_rows_read( 0 )
+
 {
 	//
 }
 
 Loader::~Loader()
 {
-	//
+	EndRows();
 }
 
 //==============================================================================
@@ -48,7 +60,9 @@ Loader::~Loader()
 bool Loader::LoadTo( FileReader& reader,
 					 Image& image,
 					 ImageInfo* p_info,
-					 const uint32_t want )
+					 const uint32_t want,
+					 const uint32_t scale_x,
+					 const uint32_t scale_y )
 {
 	// No error.
 	m_last_error.clear();
@@ -79,7 +93,7 @@ bool Loader::LoadTo( FileReader& reader,
 	case ImageSourceFormat::PNG:
 		{
 			cPNG png;
-			success = png.LoadTo( reader, image, p_info, want, m_last_error );
+			success = png.LoadTo( reader, image, p_info, want, scale_x, scale_y, m_last_error );
 		}
 		break;
 
@@ -110,3 +124,166 @@ ImageSourceFormat Loader::Identify( const FileReader& reader ) const
 }
 
 //==============================================================================
+
+//------------------------------------------------------------------------------
+// Loader::BeginRows
+//------------------------------------------------------------------------------
+bool Loader::BeginRows( FileReader& reader,
+						ImageInfo* p_info,
+						const uint32_t scale_x,
+						const uint32_t scale_y )
+{
+	// No error.
+	m_last_error.clear();
+
+	// Start afresh.
+	EndRows();
+
+	// Reset info
+	if ( p_info )
+	{
+		p_info->Reset();
+	}
+
+	// Only PNG can be read by row.
+	if ( Identify( reader ) != ImageSourceFormat::PNG )
+	{
+		return false;
+	}
+
+	m_rows_info.Reset();
+	m_p_rows_info = p_info ? p_info : &m_rows_info;
+	m_rows_scale_x = scale_x;
+	m_rows_scale_y = scale_y;
+
+	const uint32_t start = reader.GetReadCursor();
+
+	bool interlaced;
+	m_p_png.reset( new cPNG() );
+	if ( m_p_png->BeginRows( reader, m_p_rows_info, &interlaced, m_last_error ) == false )
+	{
+		m_p_png.reset();
+
+		if ( interlaced == false || reader.Seek( start ) == false )
+		{
+			return false;
+		}
+
+		// Interlaced: the last pass fills every row, so decode the lot.
+		m_p_whole.reset( new Image() );
+		if ( LoadTo( reader, *m_p_whole, m_p_rows_info, WANT_IDX8, scale_x, scale_y ) == false )
+		{
+			m_p_whole.reset();
+			return false;
+		}
+	}
+
+	m_rows_width = m_p_rows_info->width * scale_x;
+	m_rows_height = m_p_rows_info->height * scale_y;
+
+	// Room for the widen kernel to work in place.
+	m_row_buffer.resize( m_rows_width + 64 );
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Loader::ReadRow
+//------------------------------------------------------------------------------
+bool Loader::ReadRow( uint8_t* p_dst8 )
+{
+	const uint8_t* p_row = NextRow();
+	if ( p_row == nullptr )
+	{
+		return false;
+	}
+
+	memcpy( p_dst8, p_row, m_rows_width );
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Loader::ReadRow
+//------------------------------------------------------------------------------
+bool Loader::ReadRow( Image& image, uint32_t y )
+{
+	const uint8_t* p_row = NextRow();
+	if ( p_row == nullptr )
+	{
+		return false;
+	}
+
+	// Pack from the row buffer, with the padding up to the stride as border.
+	uint8_t* p_buffer = m_row_buffer.data();
+	if ( p_row != p_buffer )
+	{
+		memcpy( p_buffer, p_row, m_rows_width );
+	}
+	memset( p_buffer + m_rows_width, 0, image.GetStride() - m_rows_width );
+
+	image.PackRow( y, p_buffer );
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Loader::NextRow
+//------------------------------------------------------------------------------
+const uint8_t* Loader::NextRow()
+{
+	if ( m_rows_read >= m_rows_height )
+	{
+		return nullptr;
+	}
+
+	const uint8_t* p_row;
+	if ( m_p_whole )
+	{
+		p_row = m_p_whole->GetRowPtr( m_rows_read );
+	}
+	else
+	{
+		if ( m_p_png == nullptr )
+		{
+			return nullptr;
+		}
+
+		// Decode a new source row, then repeat it scale_y times.
+		if ( ( m_rows_read % m_rows_scale_y ) == 0 )
+		{
+			if ( m_p_png->ReadRow( m_row_buffer.data(), &m_p_rows_info->uMaxIndex ) == false )
+			{
+				m_last_error = "Failed to read a row.";
+				return nullptr;
+			}
+
+			if ( m_rows_scale_x > 1 )
+			{
+				GetWidenRowKernel()( m_row_buffer.data(), m_rows_width / m_rows_scale_x, m_rows_scale_x );
+			}
+		}
+
+		p_row = m_row_buffer.data();
+	}
+
+	++m_rows_read;
+	return p_row;
+}
+
+//------------------------------------------------------------------------------
+// Loader::EndRows
+//------------------------------------------------------------------------------
+void Loader::EndRows()
+{
+	m_p_png.reset();
+	m_p_whole.reset();
+	m_row_buffer.clear();
+
+	m_p_rows_info = nullptr;
+	m_rows_width = 0;
+	m_rows_height = 0;
+	m_rows_scale_x = 1;
+	m_rows_scale_y = 1;
+	m_rows_read = 0;
+}
+
+//==============================================================================
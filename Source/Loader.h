@@ -24,12 +24,15 @@ SOFTWARE.
 
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "ImageInfo.h"
 
 class Image;
 class FileReader;
+class cPNG;
 
 //==============================================================================
 
@@ -117,10 +120,48 @@ public:
 	// \param reader Read an image from the current read cursor.
 	// \param info Pointer to storage for information about the image. Can be NULL.
 	// \param want Our demands. See eWant.
+	// \param scale_x, scale_y Scale up the image by repeating pixels. Only for
+	//        8-bit wants. The info still describes the source image.
 	//
 	// \return true if the image was loaded successfully and can meet our requirements.
 	//
-	bool LoadTo( FileReader& reader, Image& image, ImageInfo* p_info, const uint32_t want );
+	bool LoadTo( FileReader& reader, Image& image, ImageInfo* p_info, const uint32_t want, const uint32_t scale_x = 1, const uint32_t scale_y = 1 );
+
+	//
+	// BeginRows
+	//
+	// Start reading an indexed image a row at a time, as WANT_IDX8, so only a
+	// row of the image is held in memory. Interlaced images are loaded whole
+	// instead, and handed out a row at a time all the same. The reader must
+	// stay alive until EndRows.
+	//
+	// \param scale_x, scale_y Scale up the image by repeating pixels. The info
+	//        still describes the source image.
+	//
+	bool BeginRows( FileReader& reader, ImageInfo* p_info, const uint32_t scale_x = 1, const uint32_t scale_y = 1 );
+
+	//
+	// ReadRow
+	//
+	// Read the next of the height * scale_y rows, as width * scale_x CHUNKY_8
+	// indices. The info's uMaxIndex grows as rows are read.
+	//
+	bool ReadRow( uint8_t* p_dst8 );
+
+	//
+	// ReadRow
+	//
+	// Read the next row straight into row y of an image of any linear pixel
+	// format, width * scale_x pixels wide. Pixels past the width are index zero.
+	//
+	bool ReadRow( Image& image, uint32_t y );
+
+	//
+	// EndRows
+	//
+	// Finish reading rows. Safe to call at any time.
+	//
+	void EndRows();
 
 	//
 	// GetLastError
@@ -135,6 +176,9 @@ public:
 
 private:
 
+	// Decode the next row, returning its CHUNKY_8 indices, or nullptr on failure.
+	const uint8_t* NextRow();
+
 	//--------------------------------------------------------------------------
 	// Implementation Data
 	//--------------------------------------------------------------------------
@@ -142,4 +186,16 @@ private:
 	// Last Error
 	std::string m_last_error;
 
+	// Row reading state. See BeginRows.
+	ImageInfo m_rows_info;
+	std::unique_ptr< cPNG > m_p_png;
+	std::unique_ptr< Image > m_p_whole;
+	std::vector< uint8_t > m_row_buffer;
+	ImageInfo* m_p_rows_info;
+	uint32_t m_rows_width;
+	uint32_t m_rows_height;
+	uint32_t m_rows_scale_x;
+	uint32_t m_rows_scale_y;
+	uint32_t m_rows_read;
+
 };
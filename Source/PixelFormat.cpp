@@ -27,6 +27,7 @@ SOFTWARE.
 #include <cstdint>
 
 #include "PixelFormat.h"
+#include "PixelFormatTraits.h"
 
 //------------------------------------------------------------------------------
 // DecodePixelFormat
@@ -139,40 +140,7 @@ const char* PixelFormatToString( PixelFormat pf )
 //------------------------------------------------------------------------------
 uint32_t PixelFormatMaxIndex( PixelFormat format )
 {
-	switch ( format )
-	{
-
-	default:
-	case PixelFormat::UNKNOWN:
-	case PixelFormat::CHUNKY_16:
-	case PixelFormat::CHUNKY_32:
-		return 0; // Invalid
-
-	case PixelFormat::PACKED_1:
-	case PixelFormat::ATART_ST_M2:
-	case PixelFormat::AMSTRAD_CPC_M2:
-		return 1 << 1; // 2 colours
-
-	case PixelFormat::PACKED_2:
-	case PixelFormat::ATART_ST_M1:
-	case PixelFormat::AMSTRAD_CPC_M1:
-	case PixelFormat::IBM_CGA:
-	case PixelFormat::NES:
-	case PixelFormat::GAMEBOY:
-		return 1 << 2; // 4 colours
-
-	case PixelFormat::PACKED_4:
-	case PixelFormat::ATART_ST_M0:
-	case PixelFormat::AMSTRAD_CPC_M0:
-	case PixelFormat::MASTER_SYSTEM:
-		return 1 << 4; // 16 colours
-		break;
-
-	case PixelFormat::CHUNKY_8:
-		return 1 << 8; // 256 colours
-		break;
-
-	}; // switch ( format )
+	return DispatchPixelFormat( format, []( auto traits ) { return decltype( traits )::kMaxIndex; } );
 }
 
 //------------------------------------------------------------------------------
@@ -180,17 +148,13 @@ uint32_t PixelFormatMaxIndex( PixelFormat format )
 //------------------------------------------------------------------------------
 bool PixelFormatIsPattern8x8( PixelFormat format )
 {
-	switch ( format )
-	{
-
-	default:
-	case PixelFormat::UNKNOWN:
-		return false;
-
-	case PixelFormat::MASTER_SYSTEM:
-	case PixelFormat::GAMEBOY:
-	case PixelFormat::NES:
-		return true;
+	return DispatchPixelFormat( format, []( auto traits ) { return decltype( traits )::kIsPattern8x8; } );
+}
 
-	}
+//------------------------------------------------------------------------------
+// PixelFormatUnitPixels
+//------------------------------------------------------------------------------
+int PixelFormatUnitPixels( PixelFormat format )
+{
+	return DispatchPixelFormat( format, []( auto traits ) { return decltype( traits )::kUnitPixels; } );
 }
@@ -93,3 +93,6 @@ uint32_t PixelFormatMaxIndex( PixelFormat format );
 // Returns true if this is an 8x8 pattern based pixel format.
 bool PixelFormatIsPattern8x8( PixelFormat format );
 
+// Pixels per byte, or per block for the planar formats.
+int PixelFormatUnitPixels( PixelFormat format );
+
@@ -0,0 +1,149 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "PixelFormat.h"
+
+// Compile-time description of each pixel format.
+//
+// Pixels are stored in units: kUnitPixels pixels packed into kUnitBytes bytes.
+// Consecutive units along a row are kUnitStep bytes apart, which is only
+// different from kUnitBytes for tile-linear formats.
+//
+// Code that works on a whole image should be a template on the traits, and
+// call DispatchPixelFormat once to pick the right instantiation.
+
+template< int BITS, int UNIT_PIXELS, int UNIT_BYTES, bool BIGEND = false, int TILE = 1, bool TILE_LINEAR = false >
+struct PixelFormatTraitsBase
+{
+	// Index bits per pixel.
+	static constexpr int kBitsPerPixel = BITS;
+
+	// Packing unit.
+	static constexpr int kUnitPixels = UNIT_PIXELS;
+	static constexpr int kUnitBytes = UNIT_BYTES;
+
+	// Multi-byte units are big-endian (otherwise native).
+	static constexpr bool kBigEndian = BIGEND;
+
+	// Width and height are multiples of the tile size (1 for non-pattern formats).
+	static constexpr int kTileW = TILE;
+	static constexpr int kTileH = TILE;
+	static constexpr bool kIsPattern8x8 = ( TILE == 8 );
+
+	// Tiles are stored one after another, rather than row by row.
+	static constexpr bool kTileLinear = TILE_LINEAR;
+
+	// Byte distance between consecutive units along a row.
+	static constexpr int kUnitStep = TILE_LINEAR ? ( UNIT_BYTES * TILE ) : UNIT_BYTES;
+
+	// Max permitted index, or 0 if indices aren't limited to 8 bits.
+	static constexpr uint32_t kMaxIndex = ( BITS > 0 && BITS <= 8 ) ? ( 1u << BITS ) : 0;
+
+	// Bytes per row for a given width.
+	static constexpr uint32_t Pitch( uint32_t width )
+	{
+		return ( ( width + UNIT_PIXELS - 1 ) / UNIT_PIXELS ) * UNIT_BYTES;
+	}
+
+	// Pixels per row, including padding, for a given pitch.
+	static constexpr uint32_t Stride( uint32_t pitch )
+	{
+		return UNIT_BYTES ? ( pitch / UNIT_BYTES ) * UNIT_PIXELS : 0;
+	}
+
+	// Round a width or height up to the tile size.
+	static constexpr uint32_t AlignW( uint32_t width )
+	{
+		return ( ( width + TILE - 1 ) / TILE ) * TILE;
+	}
+
+	static constexpr uint32_t AlignH( uint32_t height )
+	{
+		return ( ( height + TILE - 1 ) / TILE ) * TILE;
+	}
+};
+
+template< PixelFormat FORMAT >
+struct PixelFormatTraits;
+
+#define PIXEL_FORMAT_TRAITS( FORMAT, ... ) \
+	template<> struct PixelFormatTraits< PixelFormat::FORMAT > : PixelFormatTraitsBase< __VA_ARGS__ > \
+	{ \
+		static constexpr PixelFormat kFormat = PixelFormat::FORMAT; \
+	}
+
+//                  format          bits  unit px  unit bytes  big-endian  tile  tile-linear
+PIXEL_FORMAT_TRAITS( UNKNOWN,        0,    1,       0 );
+PIXEL_FORMAT_TRAITS( PACKED_1,       1,    8,       1 );
+PIXEL_FORMAT_TRAITS( PACKED_2,       2,    4,       1 );
+PIXEL_FORMAT_TRAITS( PACKED_4,       4,    2,       1 );
+PIXEL_FORMAT_TRAITS( CHUNKY_8,       8,    1,       1 );
+PIXEL_FORMAT_TRAITS( CHUNKY_16,      16,   1,       2 );
+PIXEL_FORMAT_TRAITS( CHUNKY_32,      32,   1,       4 );
+PIXEL_FORMAT_TRAITS( ATART_ST_M0,    4,    16,      8,          true );
+PIXEL_FORMAT_TRAITS( ATART_ST_M1,    2,    16,      4,          true );
+PIXEL_FORMAT_TRAITS( ATART_ST_M2,    1,    16,      2,          true );
+PIXEL_FORMAT_TRAITS( AMSTRAD_CPC_M0, 4,    2,       1 );
+PIXEL_FORMAT_TRAITS( AMSTRAD_CPC_M1, 2,    4,       1 );
+PIXEL_FORMAT_TRAITS( AMSTRAD_CPC_M2, 1,    8,       1 );
+PIXEL_FORMAT_TRAITS( IBM_CGA,        2,    4,       1 );
+PIXEL_FORMAT_TRAITS( MASTER_SYSTEM,  4,    8,       4,          false,      8 );
+PIXEL_FORMAT_TRAITS( GAMEBOY,        2,    8,       2,          false,      8 );
+PIXEL_FORMAT_TRAITS( NES,            2,    8,       2,          false,      8,    true );
+
+#undef PIXEL_FORMAT_TRAITS
+
+// Call fn( PixelFormatTraits< format >() ) and return the result. This is the
+// only run-time switch on the format; fn is instantiated once per format.
+template< typename FN >
+inline auto DispatchPixelFormat( PixelFormat format, FN&& fn ) -> decltype( fn( PixelFormatTraits< PixelFormat::UNKNOWN >() ) )
+{
+	switch ( format )
+	{
+
+	default:
+	case PixelFormat::UNKNOWN:			return fn( PixelFormatTraits< PixelFormat::UNKNOWN >() );
+	case PixelFormat::PACKED_1:			return fn( PixelFormatTraits< PixelFormat::PACKED_1 >() );
+	case PixelFormat::PACKED_2:			return fn( PixelFormatTraits< PixelFormat::PACKED_2 >() );
+	case PixelFormat::PACKED_4:			return fn( PixelFormatTraits< PixelFormat::PACKED_4 >() );
+	case PixelFormat::CHUNKY_8:			return fn( PixelFormatTraits< PixelFormat::CHUNKY_8 >() );
+	case PixelFormat::CHUNKY_16:		return fn( PixelFormatTraits< PixelFormat::CHUNKY_16 >() );
+	case PixelFormat::CHUNKY_32:		return fn( PixelFormatTraits< PixelFormat::CHUNKY_32 >() );
+	case PixelFormat::ATART_ST_M0:		return fn( PixelFormatTraits< PixelFormat::ATART_ST_M0 >() );
+	case PixelFormat::ATART_ST_M1:		return fn( PixelFormatTraits< PixelFormat::ATART_ST_M1 >() );
+	case PixelFormat::ATART_ST_M2:		return fn( PixelFormatTraits< PixelFormat::ATART_ST_M2 >() );
+	case PixelFormat::AMSTRAD_CPC_M0:	return fn( PixelFormatTraits< PixelFormat::AMSTRAD_CPC_M0 >() );
+	case PixelFormat::AMSTRAD_CPC_M1:	return fn( PixelFormatTraits< PixelFormat::AMSTRAD_CPC_M1 >() );
+	case PixelFormat::AMSTRAD_CPC_M2:	return fn( PixelFormatTraits< PixelFormat::AMSTRAD_CPC_M2 >() );
+	case PixelFormat::IBM_CGA:			return fn( PixelFormatTraits< PixelFormat::IBM_CGA >() );
+	case PixelFormat::MASTER_SYSTEM:	return fn( PixelFormatTraits< PixelFormat::MASTER_SYSTEM >() );
+	case PixelFormat::GAMEBOY:			return fn( PixelFormatTraits< PixelFormat::GAMEBOY >() );
+	case PixelFormat::NES:				return fn( PixelFormatTraits< PixelFormat::NES >() );
+
+	}
+}
@@ -0,0 +1,1104 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <cstring>
+
+#if defined( _MSC_VER )
+#include <stdlib.h>
+#define bswap64( x ) _byteswap_uint64( x )
+#else
+#define bswap64( x ) __builtin_bswap64( x )
+#endif
+
+#include "RowKernels.h"
+#include "PixelFormatTraits.h"
+#include "RowKernelsSIMD.h"
+#include "CpuFeatures.h"
+#include "IndexSet.h"
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// Block Drivers
+//------------------------------------------------------------------------------
+
+// Run a block packer along a row. BLOCK packs one unit of FORMAT (see
+// PixelFormatTraits). A partial unit at the end of the row is padded with index zero.
+template< PixelFormat FORMAT, void ( *BLOCK )( const uint8_t*, uint8_t* ) >
+static void packRow( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	typedef PixelFormatTraits< FORMAT > Traits;
+
+	for ( ; count >= Traits::kUnitPixels; count -= Traits::kUnitPixels )
+	{
+		BLOCK( pSrc8, pDst );
+		pSrc8 += Traits::kUnitPixels;
+		pDst += Traits::kUnitStep;
+	}
+
+	if ( count > 0 )
+	{
+		uint8_t tail[ Traits::kUnitPixels ] = {};
+		memcpy( tail, pSrc8, count );
+		BLOCK( tail, pDst );
+	}
+}
+
+// Run a block packer along a row of mask values. Each index is looked up in 'set'
+// first; the padding of a partial unit is looked up as index zero.
+template< PixelFormat FORMAT, void ( *BLOCK )( const uint8_t*, uint8_t* ) >
+static void maskRow( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	typedef PixelFormatTraits< FORMAT > Traits;
+
+	const uint8_t uMatch = bInvert ? 0 : UINT8_MAX;
+	const uint8_t uNoMatch = bInvert ? UINT8_MAX : 0;
+
+	uint8_t unit[ Traits::kUnitPixels ];
+
+	for ( ; count > 0; count -= Traits::kUnitPixels )
+	{
+		for ( int i = 0; i < Traits::kUnitPixels; ++i )
+		{
+			const uint8_t value = ( i < count ) ? pSrc8[ i ] : 0;
+			unit[ i ] = set.Contains( value ) ? uMatch : uNoMatch;
+		}
+
+		BLOCK( unit, pDst );
+		pSrc8 += Traits::kUnitPixels;
+		pDst += Traits::kUnitStep;
+	}
+}
+
+// Run a block unpacker along a row. BLOCK unpacks one unit of FORMAT.
+template< PixelFormat FORMAT, void ( *BLOCK )( const uint8_t*, uint8_t* ) >
+static void unpackRow( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	typedef PixelFormatTraits< FORMAT > Traits;
+
+	for ( ; count >= Traits::kUnitPixels; count -= Traits::kUnitPixels )
+	{
+		BLOCK( pSrc, pDst8 );
+		pSrc += Traits::kUnitStep;
+		pDst8 += Traits::kUnitPixels;
+	}
+
+	if ( count > 0 )
+	{
+		uint8_t tail[ Traits::kUnitPixels ];
+		BLOCK( pSrc, tail );
+		memcpy( pDst8, tail, count );
+	}
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// PACKED_1 / AMSTRAD_CPC_M2 - 8 pixels per byte, MSB = left.
+//------------------------------------------------------------------------------
+
+static void packBlock_1bpp( const uint8_t* s, uint8_t* d )
+{
+	uint8_t b = 0;
+	for ( int i = 0; i < 8; ++i )
+	{
+		b |= ( s[ i ] & 1 ) << ( 7 - i );
+	}
+	d[ 0 ] = b;
+}
+
+static void unpackBlock_1bpp( const uint8_t* s, uint8_t* d )
+{
+	for ( int i = 0; i < 8; ++i )
+	{
+		d[ i ] = ( s[ 0 ] >> ( 7 - i ) ) & 1;
+	}
+}
+
+//------------------------------------------------------------------------------
+// PACKED_2 / IBM_CGA - 4 pixels per byte, MSB = pixel 0.
+//------------------------------------------------------------------------------
+
+static void packBlock_2bpp( const uint8_t* s, uint8_t* d )
+{
+	uint8_t b = 0;
+	for ( int i = 0; i < 4; ++i )
+	{
+		b |= ( s[ i ] & 3 ) << ( ( 3 - i ) << 1 );
+	}
+	d[ 0 ] = b;
+}
+
+static void unpackBlock_2bpp( const uint8_t* s, uint8_t* d )
+{
+	for ( int i = 0; i < 4; ++i )
+	{
+		d[ i ] = ( s[ 0 ] >> ( ( 3 - i ) << 1 ) ) & 3;
+	}
+}
+
+//------------------------------------------------------------------------------
+// PACKED_4 - 2 pixels per byte, bits 7:4 = left.
+//------------------------------------------------------------------------------
+
+static void packBlock_4bpp( const uint8_t* s, uint8_t* d )
+{
+	d[ 0 ] = static_cast< uint8_t >( ( s[ 0 ] << 4 ) | ( s[ 1 ] & 0xF ) );
+}
+
+static void unpackBlock_4bpp( const uint8_t* s, uint8_t* d )
+{
+	d[ 0 ] = s[ 0 ] >> 4;
+	d[ 1 ] = s[ 0 ] & 0xF;
+}
+
+//------------------------------------------------------------------------------
+// CHUNKY_8 / CHUNKY_16 / CHUNKY_32
+//------------------------------------------------------------------------------
+
+static void packRow_Chunky8( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	memcpy( pDst, pSrc8, count );
+}
+
+static void unpackRow_Chunky8( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	memcpy( pDst8, pSrc, count );
+}
+
+static void packBlock_Chunky8( const uint8_t* s, uint8_t* d )
+{
+	d[ 0 ] = s[ 0 ];
+}
+
+static void packBlock_Chunky16( const uint8_t* s, uint8_t* d )
+{
+	const uint16_t value = s[ 0 ];
+	memcpy( d, &value, sizeof( value ) );
+}
+
+static void unpackBlock_Chunky16( const uint8_t* s, uint8_t* d )
+{
+	uint16_t value;
+	memcpy( &value, s, sizeof( value ) );
+	d[ 0 ] = static_cast< uint8_t >( value );
+}
+
+static void packBlock_Chunky32( const uint8_t* s, uint8_t* d )
+{
+	const uint32_t value = s[ 0 ];
+	memcpy( d, &value, sizeof( value ) );
+}
+
+static void unpackBlock_Chunky32( const uint8_t* s, uint8_t* d )
+{
+	uint32_t value;
+	memcpy( &value, s, sizeof( value ) );
+	d[ 0 ] = static_cast< uint8_t >( value );
+}
+
+//------------------------------------------------------------------------------
+// ATART_ST_M0 / M1 / M2 - 16 pixels x N planes of big-endian words, MSB = left.
+// Each plane word is two MSB-left bytes, so it's built like 1bpp.
+//------------------------------------------------------------------------------
+
+template< int PLANES >
+static void packBlock_ST( const uint8_t* s, uint8_t* d )
+{
+	for ( int k = 0; k < PLANES; ++k )
+	{
+		uint8_t hi = 0, lo = 0;
+		for ( int i = 0; i < 8; ++i )
+		{
+			hi |= ( ( s[ i ] >> k ) & 1 ) << ( 7 - i );
+			lo |= ( ( s[ i + 8 ] >> k ) & 1 ) << ( 7 - i );
+		}
+		d[ k * 2 ] = hi;
+		d[ k * 2 + 1 ] = lo;
+	}
+}
+
+template< int PLANES >
+static void unpackBlock_ST( const uint8_t* s, uint8_t* d )
+{
+	for ( int i = 0; i < 16; ++i )
+	{
+		uint8_t index = 0;
+		for ( int k = 0; k < PLANES; ++k )
+		{
+			index |= ( ( s[ k * 2 + ( i >> 3 ) ] >> ( 7 - ( i & 7 ) ) ) & 1 ) << k;
+		}
+		d[ i ] = index;
+	}
+}
+
+//------------------------------------------------------------------------------
+// AMSTRAD_CPC_M0 - 2 pixels per byte, eccentric ordering.
+//------------------------------------------------------------------------------
+
+// Destination bit for each index bit of pixel 0. Pixel 1 is one bit lower.
+static const uint8_t gCpc0Bit[ 4 ] = { 7, 3, 5, 1 };
+
+// Pixel 0's bits for each 4-bit index, spread out as per gCpc0Bit.
+static const uint8_t gCpc0Spread[ 16 ] =
+{
+	0x00, 0x80, 0x08, 0x88, 0x20, 0xA0, 0x28, 0xA8, 0x02, 0x82, 0x0A, 0x8A, 0x22, 0xA2, 0x2A, 0xAA,
+};
+
+static void packBlock_Cpc0( const uint8_t* s, uint8_t* d )
+{
+	d[ 0 ] = gCpc0Spread[ s[ 0 ] & 0xF ] | ( gCpc0Spread[ s[ 1 ] & 0xF ] >> 1 );
+}
+
+
+//------------------------------------------------------------------------------
+// AMSTRAD_CPC_M1 - 4 pixels per byte, bit 0 in the high nibble, bit 1 in the low.
+//------------------------------------------------------------------------------
+
+// CPC mode 1 byte for each PACKED_2 byte. Both hold 4 pixels of 2 bits, so the
+// CPC ordering is a straight permutation of the bits.
+static const uint8_t gCpc1FromPacked2[ 256 ] =
+{
+	0x00, 0x10, 0x01, 0x11, 0x20, 0x30, 0x21, 0x31, 0x02, 0x12, 0x03, 0x13, 0x22, 0x32, 0x23, 0x33,
+	0x40, 0x50, 0x41, 0x51, 0x60, 0x70, 0x61, 0x71, 0x42, 0x52, 0x43, 0x53, 0x62, 0x72, 0x63, 0x73,
+	0x04, 0x14, 0x05, 0x15, 0x24, 0x34, 0x25, 0x35, 0x06, 0x16, 0x07, 0x17, 0x26, 0x36, 0x27, 0x37,
+	0x44, 0x54, 0x45, 0x55, 0x64, 0x74, 0x65, 0x75, 0x46, 0x56, 0x47, 0x57, 0x66, 0x76, 0x67, 0x77,
+	0x80, 0x90, 0x81, 0x91, 0xA0, 0xB0, 0xA1, 0xB1, 0x82, 0x92, 0x83, 0x93, 0xA2, 0xB2, 0xA3, 0xB3,
+	0xC0, 0xD0, 0xC1, 0xD1, 0xE0, 0xF0, 0xE1, 0xF1, 0xC2, 0xD2, 0xC3, 0xD3, 0xE2, 0xF2, 0xE3, 0xF3,
+	0x84, 0x94, 0x85, 0x95, 0xA4, 0xB4, 0xA5, 0xB5, 0x86, 0x96, 0x87, 0x97, 0xA6, 0xB6, 0xA7, 0xB7,
+	0xC4, 0xD4, 0xC5, 0xD5, 0xE4, 0xF4, 0xE5, 0xF5, 0xC6, 0xD6, 0xC7, 0xD7, 0xE6, 0xF6, 0xE7, 0xF7,
+	0x08, 0x18, 0x09, 0x19, 0x28, 0x38, 0x29, 0x39, 0x0A, 0x1A, 0x0B, 0x1B, 0x2A, 0x3A, 0x2B, 0x3B,
+	0x48, 0x58, 0x49, 0x59, 0x68, 0x78, 0x69, 0x79, 0x4A, 0x5A, 0x4B, 0x5B, 0x6A, 0x7A, 0x6B, 0x7B,
+	0x0C, 0x1C, 0x0D, 0x1D, 0x2C, 0x3C, 0x2D, 0x3D, 0x0E, 0x1E, 0x0F, 0x1F, 0x2E, 0x3E, 0x2F, 0x3F,
+	0x4C, 0x5C, 0x4D, 0x5D, 0x6C, 0x7C, 0x6D, 0x7D, 0x4E, 0x5E, 0x4F, 0x5F, 0x6E, 0x7E, 0x6F, 0x7F,
+	0x88, 0x98, 0x89, 0x99, 0xA8, 0xB8, 0xA9, 0xB9, 0x8A, 0x9A, 0x8B, 0x9B, 0xAA, 0xBA, 0xAB, 0xBB,
+	0xC8, 0xD8, 0xC9, 0xD9, 0xE8, 0xF8, 0xE9, 0xF9, 0xCA, 0xDA, 0xCB, 0xDB, 0xEA, 0xFA, 0xEB, 0xFB,
+	0x8C, 0x9C, 0x8D, 0x9D, 0xAC, 0xBC, 0xAD, 0xBD, 0x8E, 0x9E, 0x8F, 0x9F, 0xAE, 0xBE, 0xAF, 0xBF,
+	0xCC, 0xDC, 0xCD, 0xDD, 0xEC, 0xFC, 0xED, 0xFD, 0xCE, 0xDE, 0xCF, 0xDF, 0xEE, 0xFE, 0xEF, 0xFF,
+};
+
+static void packBlock_Cpc1( const uint8_t* s, uint8_t* d )
+{
+	const uint8_t packed2 = static_cast< uint8_t >(
+		( ( s[ 0 ] & 3 ) << 6 ) | ( ( s[ 1 ] & 3 ) << 4 ) | ( ( s[ 2 ] & 3 ) << 2 ) | ( s[ 3 ] & 3 ) );
+
+	d[ 0 ] = gCpc1FromPacked2[ packed2 ];
+}
+
+// Both CPC modes unpack through a table of every possible byte.
+struct CpcUnpackTables
+{
+	uint8_t mode0[ 256 ][ 2 ];
+	uint8_t mode1[ 256 ][ 4 ];
+
+	CpcUnpackTables()
+	{
+		for ( int b = 0; b < 256; ++b )
+		{
+			mode0[ b ][ 0 ] = 0;
+			mode0[ b ][ 1 ] = 0;
+			for ( int k = 0; k < 4; ++k )
+			{
+				mode0[ b ][ 0 ] |= ( ( b >> gCpc0Bit[ k ] ) & 1 ) << k;
+				mode0[ b ][ 1 ] |= ( ( b >> ( gCpc0Bit[ k ] - 1 ) ) & 1 ) << k;
+			}
+
+			for ( int i = 0; i < 4; ++i )
+			{
+				mode1[ b ][ i ] = ( ( b >> ( 7 - i ) ) & 1 ) | ( ( ( b >> ( 3 - i ) ) & 1 ) << 1 );
+			}
+		}
+	}
+};
+
+static const CpcUnpackTables gCpcUnpack;
+
+static void unpackBlock_Cpc0( const uint8_t* s, uint8_t* d )
+{
+	memcpy( d, gCpcUnpack.mode0[ s[ 0 ] ], 2 );
+}
+
+static void unpackBlock_Cpc1( const uint8_t* s, uint8_t* d )
+{
+	memcpy( d, gCpcUnpack.mode1[ s[ 0 ] ], 4 );
+}
+
+//------------------------------------------------------------------------------
+// MASTER_SYSTEM / GAMEBOY / NES - 8 pixels x N planes of bytes, MSB = left.
+// STEP is the byte distance between planes (1 = interleaved, 8 = NES tile).
+//------------------------------------------------------------------------------
+
+template< int PLANES, int STEP >
+static void packBlock_Planar8( const uint8_t* s, uint8_t* d )
+{
+	for ( int k = 0; k < PLANES; ++k )
+	{
+		uint8_t b = 0;
+		for ( int i = 0; i < 8; ++i )
+		{
+			b |= ( ( s[ i ] >> k ) & 1 ) << ( 7 - i );
+		}
+		d[ k * STEP ] = b;
+	}
+}
+
+template< int PLANES, int STEP >
+static void unpackBlock_Planar8( const uint8_t* s, uint8_t* d )
+{
+	for ( int i = 0; i < 8; ++i )
+	{
+		uint8_t index = 0;
+		for ( int k = 0; k < PLANES; ++k )
+		{
+			index |= ( ( s[ k * STEP ] >> ( 7 - i ) ) & 1 ) << k;
+		}
+		d[ i ] = index;
+	}
+}
+
+// Encode a whole pattern, one row of pixels at a time.
+template< int PLANES, int STEP >
+static void encodeTile_Planar8( const uint8_t* pSrc8, int srcPitch, uint8_t* pDst )
+{
+	// ... NES keeps its planes 8 bytes apart, so rows are 1 byte apart.
+	const int rowBytes = ( STEP == 1 ) ? PLANES : 1;
+
+	for ( int y = 0; y < 8; ++y )
+	{
+		packBlock_Planar8< PLANES, STEP >( pSrc8 + y * srcPitch, pDst + y * rowBytes );
+	}
+}
+
+// Decode a whole pattern, one row of pixels at a time.
+template< int PLANES, int STEP >
+static void decodeTile_Planar8( const uint8_t* pSrc, uint8_t* pDst8, int dstPitch )
+{
+	const int rowBytes = ( STEP == 1 ) ? PLANES : 1;
+
+	for ( int y = 0; y < 8; ++y )
+	{
+		unpackBlock_Planar8< PLANES, STEP >( pSrc + y * rowBytes, pDst8 + y * dstPitch );
+	}
+}
+
+//------------------------------------------------------------------------------
+// Row Shifting - done on packed rows, a byte or a plane word at a time.
+//------------------------------------------------------------------------------
+
+// Byte formats: P pixels per byte, D bits between neighbouring pixels in a plane,
+// PIXEL0 the bits of the left-most pixel. This covers both the plain bit stream
+// formats (D = bits per pixel) and the CPC's interleaved planes (D = 1).
+//
+// Shifting by r pixels moves pixels r to P-1 down from the same source byte, and
+// carries pixels 0 to r-1 over from the byte before. Whole bytes are just an offset.
+template< int P, int D, uint8_t PIXEL0 >
+static void shiftRow_Bytes( const uint8_t* pSrc, int count, int shift, const uint8_t* pFill, uint8_t* pDst )
+{
+	const int srcBytes = ( count + P - 1 ) / P;
+	const int dstPixels = count + shift;
+	const int dstBytes = ( dstPixels + P - 1 ) / P;
+	const int q = shift / P;
+	const int r = shift % P;
+	const uint8_t fill = pFill[ 0 ];
+
+	uint8_t keep = 0;
+	for ( int i = r; i < P; ++i )
+	{
+		keep |= PIXEL0 >> ( i * D );
+	}
+
+	const uint8_t carry = static_cast< uint8_t >( ~keep );
+	const int curShift = r * D;
+	const int prevShift = ( P - r ) * D;
+
+	// ... source byte j, with the border either side.
+	auto source = [ & ]( int j ) -> uint8_t
+	{
+		return ( j >= 0 && j < srcBytes ) ? pSrc[ j ] : fill;
+	};
+
+	auto shiftByte = [ & ]( uint8_t cur, uint8_t prev ) -> uint8_t
+	{
+		return static_cast< uint8_t >( ( ( cur >> curShift ) & keep ) | ( ( prev << prevShift ) & carry ) );
+	};
+
+	int k = 0;
+
+	// Left edge, where the previous byte is border.
+	for ( ; k < dstBytes && k <= q; ++k )
+	{
+		pDst[ k ] = shiftByte( source( k - q ), source( k - q - 1 ) );
+	}
+
+	// Middle, 8 bytes at a time. The words are byte swapped so that the whole row is
+	// one big-endian bit stream, and the masks keep each byte's bits to itself.
+	const uint64_t keep64 = keep * 0x0101010101010101ULL;
+	const uint64_t carry64 = carry * 0x0101010101010101ULL;
+
+	for ( ; k + 8 <= dstBytes && k - q + 8 <= srcBytes; k += 8 )
+	{
+		uint64_t cur;
+		memcpy( &cur, pSrc + k - q, sizeof( cur ) );
+		cur = bswap64( cur );
+
+		const uint64_t prev = ( cur >> 8 ) | ( static_cast< uint64_t >( pSrc[ k - q - 1 ] ) << 56 );
+
+		uint64_t out = ( ( cur >> curShift ) & keep64 ) | ( ( prev << prevShift ) & carry64 );
+		out = bswap64( out );
+		memcpy( pDst + k, &out, sizeof( out ) );
+	}
+
+	// Right edge.
+	for ( ; k < dstBytes; ++k )
+	{
+		pDst[ k ] = shiftByte( source( k - q ), source( k - q - 1 ) );
+	}
+
+	// The source's own padding was shifted in, replace it with border.
+	const int tail = dstPixels % P;
+	if ( tail )
+	{
+		uint8_t used = 0;
+		for ( int i = 0; i < tail; ++i )
+		{
+			used |= PIXEL0 >> ( i * D );
+		}
+
+		pDst[ dstBytes - 1 ] = static_cast< uint8_t >( ( pDst[ dstBytes - 1 ] & used ) | ( fill & ~used ) );
+	}
+}
+
+// Atari ST: each plane is a stream of 16-pixel big-endian words.
+template< int PLANES >
+static void shiftRow_ST( const uint8_t* pSrc, int count, int shift, const uint8_t* pFill, uint8_t* pDst )
+{
+	const int srcBlocks = ( count + 15 ) / 16;
+	const int dstPixels = count + shift;
+	const int dstBlocks = ( dstPixels + 15 ) / 16;
+	const int q = shift / 16;
+	const int r = shift % 16;
+
+	// ... plane k of source block j, with the border either side.
+	auto source = [ & ]( int j, int k ) -> uint32_t
+	{
+		const uint8_t* p = ( j >= 0 && j < srcBlocks ) ? ( pSrc + j * PLANES * 2 ) : pFill;
+		return ( p[ k * 2 ] << 8 ) | p[ k * 2 + 1 ];
+	};
+
+	// The source's own padding is shifted in too, so the last block keeps only 'used'.
+	const int tail = dstPixels % 16;
+	const uint32_t used = tail ? ( 0xFFFF0000u >> tail ) & 0xFFFF : 0xFFFF;
+
+	for ( int b = 0; b < dstBlocks; ++b )
+	{
+		for ( int k = 0; k < PLANES; ++k )
+		{
+			uint32_t word = ( ( source( b - q, k ) >> r ) | ( source( b - q - 1, k ) << ( 16 - r ) ) ) & 0xFFFF;
+
+			if ( b == dstBlocks - 1 )
+			{
+				word = ( word & used ) | ( source( -1, k ) & ~used );
+			}
+
+			pDst[ b * PLANES * 2 + k * 2 ] = static_cast< uint8_t >( word >> 8 );
+			pDst[ b * PLANES * 2 + k * 2 + 1 ] = static_cast< uint8_t >( word );
+		}
+	}
+}
+
+// Chunky formats: whole units, so it's just an offset.
+template< int UNIT_BYTES >
+static void shiftRow_Units( const uint8_t* pSrc, int count, int shift, const uint8_t* pFill, uint8_t* pDst )
+{
+	for ( int i = 0; i < shift; ++i )
+	{
+		memcpy( pDst + i * UNIT_BYTES, pFill, UNIT_BYTES );
+	}
+
+	memcpy( pDst + shift * UNIT_BYTES, pSrc, count * UNIT_BYTES );
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// Kernel Selection
+//------------------------------------------------------------------------------
+
+// Fastest pack kernel for a pixel format, given the CPU's features.
+static fnPackRow selectPackRow( PixelFormat format, const CpuFeatures& cpu )
+{
+	switch ( format )
+	{
+
+	default:
+	case PixelFormat::UNKNOWN:
+		return nullptr;
+
+	case PixelFormat::PACKED_1:
+	case PixelFormat::AMSTRAD_CPC_M2:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX512 )
+			return PackRow_1bpp_AVX512;
+		if ( cpu.bAVX2 )
+			return PackRow_1bpp_AVX2;
+		if ( cpu.bSSE2 )
+			return PackRow_1bpp_SSE2;
+#endif
+		return packRow< PixelFormat::PACKED_1, packBlock_1bpp >;
+
+	case PixelFormat::PACKED_2:
+	case PixelFormat::IBM_CGA:
+		return packRow< PixelFormat::PACKED_2, packBlock_2bpp >;
+
+	case PixelFormat::PACKED_4:
+		return packRow< PixelFormat::PACKED_4, packBlock_4bpp >;
+
+	case PixelFormat::CHUNKY_8:
+		return packRow_Chunky8;
+
+	case PixelFormat::CHUNKY_16:
+		return packRow< PixelFormat::CHUNKY_16, packBlock_Chunky16 >;
+
+	case PixelFormat::CHUNKY_32:
+		return packRow< PixelFormat::CHUNKY_32, packBlock_Chunky32 >;
+
+	case PixelFormat::ATART_ST_M0:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX512 )
+			return PackRow_ST0_AVX512;
+		if ( cpu.bAVX2 )
+			return PackRow_ST0_AVX2;
+		if ( cpu.bSSE2 )
+			return PackRow_ST0_SSE2;
+#endif
+		return packRow< PixelFormat::ATART_ST_M0, packBlock_ST< 4 > >;
+
+	case PixelFormat::ATART_ST_M1:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX512 )
+			return PackRow_ST1_AVX512;
+		if ( cpu.bAVX2 )
+			return PackRow_ST1_AVX2;
+		if ( cpu.bSSE2 )
+			return PackRow_ST1_SSE2;
+#endif
+		return packRow< PixelFormat::ATART_ST_M1, packBlock_ST< 2 > >;
+
+	case PixelFormat::ATART_ST_M2:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX512 )
+			return PackRow_ST2_AVX512;
+		if ( cpu.bAVX2 )
+			return PackRow_ST2_AVX2;
+		if ( cpu.bSSE2 )
+			return PackRow_ST2_SSE2;
+#endif
+		return packRow< PixelFormat::ATART_ST_M2, packBlock_ST< 1 > >;
+
+	case PixelFormat::AMSTRAD_CPC_M0:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bBMI2 )
+			return PackRow_Cpc0_BMI2;
+#endif
+		return packRow< PixelFormat::AMSTRAD_CPC_M0, packBlock_Cpc0 >;
+
+	case PixelFormat::AMSTRAD_CPC_M1:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bBMI2 )
+			return PackRow_Cpc1_BMI2;
+#endif
+		return packRow< PixelFormat::AMSTRAD_CPC_M1, packBlock_Cpc1 >;
+
+	case PixelFormat::MASTER_SYSTEM:
+		return packRow< PixelFormat::MASTER_SYSTEM, packBlock_Planar8< 4, 1 > >;
+
+	case PixelFormat::GAMEBOY:
+		return packRow< PixelFormat::GAMEBOY, packBlock_Planar8< 2, 1 > >;
+
+	case PixelFormat::NES:
+		return packRow< PixelFormat::NES, packBlock_Planar8< 2, 8 > >;
+
+	}
+}
+
+// Fastest unpack kernel for a pixel format, given the CPU's features.
+static fnUnpackRow selectUnpackRow( PixelFormat format, const CpuFeatures& cpu )
+{
+	switch ( format )
+	{
+
+	default:
+	case PixelFormat::UNKNOWN:
+		return nullptr;
+
+	case PixelFormat::PACKED_1:
+	case PixelFormat::AMSTRAD_CPC_M2:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX2 )
+			return UnpackRow_1bpp_AVX2;
+		if ( cpu.bSSE2 )
+			return UnpackRow_1bpp_SSE2;
+#endif
+		return unpackRow< PixelFormat::PACKED_1, unpackBlock_1bpp >;
+
+	case PixelFormat::PACKED_2:
+	case PixelFormat::IBM_CGA:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return UnpackRow_2bpp_SSE2;
+#endif
+		return unpackRow< PixelFormat::PACKED_2, unpackBlock_2bpp >;
+
+	case PixelFormat::PACKED_4:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return UnpackRow_4bpp_SSE2;
+#endif
+		return unpackRow< PixelFormat::PACKED_4, unpackBlock_4bpp >;
+
+	case PixelFormat::CHUNKY_8:
+		return unpackRow_Chunky8;
+
+	case PixelFormat::CHUNKY_16:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return UnpackRow_Chunky16_SSE2;
+#endif
+		return unpackRow< PixelFormat::CHUNKY_16, unpackBlock_Chunky16 >;
+
+	case PixelFormat::CHUNKY_32:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return UnpackRow_Chunky32_SSE2;
+#endif
+		return unpackRow< PixelFormat::CHUNKY_32, unpackBlock_Chunky32 >;
+
+	case PixelFormat::ATART_ST_M0:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX2 )
+			return UnpackRow_ST0_AVX2;
+		if ( cpu.bSSE2 )
+			return UnpackRow_ST0_SSE2;
+#endif
+		return unpackRow< PixelFormat::ATART_ST_M0, unpackBlock_ST< 4 > >;
+
+	case PixelFormat::ATART_ST_M1:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX2 )
+			return UnpackRow_ST1_AVX2;
+		if ( cpu.bSSE2 )
+			return UnpackRow_ST1_SSE2;
+#endif
+		return unpackRow< PixelFormat::ATART_ST_M1, unpackBlock_ST< 2 > >;
+
+	case PixelFormat::ATART_ST_M2:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX2 )
+			return UnpackRow_ST2_AVX2;
+		if ( cpu.bSSE2 )
+			return UnpackRow_ST2_SSE2;
+#endif
+		return unpackRow< PixelFormat::ATART_ST_M2, unpackBlock_ST< 1 > >;
+
+	case PixelFormat::AMSTRAD_CPC_M0:
+		return unpackRow< PixelFormat::AMSTRAD_CPC_M0, unpackBlock_Cpc0 >;
+
+	case PixelFormat::AMSTRAD_CPC_M1:
+		return unpackRow< PixelFormat::AMSTRAD_CPC_M1, unpackBlock_Cpc1 >;
+
+	case PixelFormat::MASTER_SYSTEM:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return UnpackRow_SMS_SSE2;
+#endif
+		return unpackRow< PixelFormat::MASTER_SYSTEM, unpackBlock_Planar8< 4, 1 > >;
+
+	case PixelFormat::GAMEBOY:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return UnpackRow_GB_SSE2;
+#endif
+		return unpackRow< PixelFormat::GAMEBOY, unpackBlock_Planar8< 2, 1 > >;
+
+	case PixelFormat::NES:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return UnpackRow_NES_SSE2;
+#endif
+		return unpackRow< PixelFormat::NES, unpackBlock_Planar8< 2, 8 > >;
+
+	}
+}
+
+// Fastest mask kernel for a pixel format, given the CPU's features.
+static fnMaskRow selectMaskRow( PixelFormat format, const CpuFeatures& cpu )
+{
+	switch ( format )
+	{
+
+	default:
+	case PixelFormat::UNKNOWN:
+		return nullptr;
+
+	case PixelFormat::PACKED_1:
+	case PixelFormat::AMSTRAD_CPC_M2:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX512 )
+			return MaskRow_1bpp_AVX512;
+		if ( cpu.bAVX2 )
+			return MaskRow_1bpp_AVX2;
+		if ( cpu.bSSE2 )
+			return MaskRow_1bpp_SSE2;
+#endif
+		return maskRow< PixelFormat::PACKED_1, packBlock_1bpp >;
+
+	case PixelFormat::PACKED_2:
+	case PixelFormat::IBM_CGA:
+		return maskRow< PixelFormat::PACKED_2, packBlock_2bpp >;
+
+	case PixelFormat::PACKED_4:
+		return maskRow< PixelFormat::PACKED_4, packBlock_4bpp >;
+
+	case PixelFormat::CHUNKY_8:
+		return maskRow< PixelFormat::CHUNKY_8, packBlock_Chunky8 >;
+
+	case PixelFormat::CHUNKY_16:
+		return maskRow< PixelFormat::CHUNKY_16, packBlock_Chunky16 >;
+
+	case PixelFormat::CHUNKY_32:
+		return maskRow< PixelFormat::CHUNKY_32, packBlock_Chunky32 >;
+
+	case PixelFormat::ATART_ST_M0:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX512 )
+			return MaskRow_ST0_AVX512;
+		if ( cpu.bAVX2 )
+			return MaskRow_ST0_AVX2;
+		if ( cpu.bSSE2 )
+			return MaskRow_ST0_SSE2;
+#endif
+		return maskRow< PixelFormat::ATART_ST_M0, packBlock_ST< 4 > >;
+
+	case PixelFormat::ATART_ST_M1:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX512 )
+			return MaskRow_ST1_AVX512;
+		if ( cpu.bAVX2 )
+			return MaskRow_ST1_AVX2;
+		if ( cpu.bSSE2 )
+			return MaskRow_ST1_SSE2;
+#endif
+		return maskRow< PixelFormat::ATART_ST_M1, packBlock_ST< 2 > >;
+
+	case PixelFormat::ATART_ST_M2:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bAVX512 )
+			return MaskRow_ST2_AVX512;
+		if ( cpu.bAVX2 )
+			return MaskRow_ST2_AVX2;
+		if ( cpu.bSSE2 )
+			return MaskRow_ST2_SSE2;
+#endif
+		return maskRow< PixelFormat::ATART_ST_M2, packBlock_ST< 1 > >;
+
+	case PixelFormat::AMSTRAD_CPC_M0:
+		return maskRow< PixelFormat::AMSTRAD_CPC_M0, packBlock_Cpc0 >;
+
+	case PixelFormat::AMSTRAD_CPC_M1:
+		return maskRow< PixelFormat::AMSTRAD_CPC_M1, packBlock_Cpc1 >;
+
+	case PixelFormat::MASTER_SYSTEM:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return MaskRow_SMS_SSE2;
+#endif
+		return maskRow< PixelFormat::MASTER_SYSTEM, packBlock_Planar8< 4, 1 > >;
+
+	case PixelFormat::GAMEBOY:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return MaskRow_GB_SSE2;
+#endif
+		return maskRow< PixelFormat::GAMEBOY, packBlock_Planar8< 2, 1 > >;
+
+	case PixelFormat::NES:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return MaskRow_NES_SSE2;
+#endif
+		return maskRow< PixelFormat::NES, packBlock_Planar8< 2, 8 > >;
+
+	}
+}
+
+// Shift kernel for a pixel format.
+static fnShiftRow selectShiftRow( PixelFormat format )
+{
+	switch ( format )
+	{
+
+	default:
+		return nullptr;
+
+	case PixelFormat::PACKED_1:
+	case PixelFormat::AMSTRAD_CPC_M2:
+		return shiftRow_Bytes< 8, 1, 0x80 >;
+
+	case PixelFormat::PACKED_2:
+	case PixelFormat::IBM_CGA:
+		return shiftRow_Bytes< 4, 2, 0xC0 >;
+
+	case PixelFormat::PACKED_4:
+		return shiftRow_Bytes< 2, 4, 0xF0 >;
+
+	case PixelFormat::CHUNKY_8:
+		return shiftRow_Units< 1 >;
+
+	case PixelFormat::CHUNKY_16:
+		return shiftRow_Units< 2 >;
+
+	case PixelFormat::CHUNKY_32:
+		return shiftRow_Units< 4 >;
+
+	case PixelFormat::ATART_ST_M0:
+		return shiftRow_ST< 4 >;
+
+	case PixelFormat::ATART_ST_M1:
+		return shiftRow_ST< 2 >;
+
+	case PixelFormat::ATART_ST_M2:
+		return shiftRow_ST< 1 >;
+
+	case PixelFormat::AMSTRAD_CPC_M0:
+		return shiftRow_Bytes< 2, 1, 0xAA >;
+
+	case PixelFormat::AMSTRAD_CPC_M1:
+		return shiftRow_Bytes< 4, 1, 0x88 >;
+
+	}
+}
+
+// Fastest tile kernel for a pixel format, given the CPU's features.
+static fnEncodeTile8x8 selectEncodeTile8x8( PixelFormat format, const CpuFeatures& cpu )
+{
+	switch ( format )
+	{
+
+	default:
+		return nullptr;
+
+	case PixelFormat::MASTER_SYSTEM:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return EncodeTile8x8_SMS_SSE2;
+#endif
+		return encodeTile_Planar8< 4, 1 >;
+
+	case PixelFormat::GAMEBOY:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return EncodeTile8x8_GB_SSE2;
+#endif
+		return encodeTile_Planar8< 2, 1 >;
+
+	case PixelFormat::NES:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return EncodeTile8x8_NES_SSE2;
+#endif
+		return encodeTile_Planar8< 2, 8 >;
+
+	}
+}
+
+// Fastest tile decoder for a pixel format, given the CPU's features.
+static fnDecodeTile8x8 selectDecodeTile8x8( PixelFormat format, const CpuFeatures& cpu )
+{
+	switch ( format )
+	{
+
+	default:
+		return nullptr;
+
+	case PixelFormat::MASTER_SYSTEM:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return DecodeTile8x8_SMS_SSE2;
+#endif
+		return decodeTile_Planar8< 4, 1 >;
+
+	case PixelFormat::GAMEBOY:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return DecodeTile8x8_GB_SSE2;
+#endif
+		return decodeTile_Planar8< 2, 1 >;
+
+	case PixelFormat::NES:
+#ifdef ROW_KERNELS_X64
+		if ( cpu.bSSE2 )
+			return DecodeTile8x8_NES_SSE2;
+#endif
+		return decodeTile_Planar8< 2, 8 >;
+
+	}
+}
+
+//------------------------------------------------------------------------------
+// Row Widening
+//------------------------------------------------------------------------------
+
+// Right to left, so no pixel is overwritten before it's read.
+static void widenRow( uint8_t* pRow, int count, int scale )
+{
+	for ( int x = count - 1; x >= 0; --x )
+	{
+		memset( pRow + x * scale, pRow[ x ], scale );
+	}
+}
+
+static fnWidenRow selectWidenRow( const CpuFeatures& cpu )
+{
+#ifdef ROW_KERNELS_X64
+	if ( cpu.bSSE2 )
+		return WidenRow_SSE2;
+#endif
+	return widenRow;
+}
+
+//==============================================================================
+
+// Kernels bound for each pixel format.
+struct BoundKernels
+{
+	fnPackRow pack;
+	fnUnpackRow unpack;
+	fnMaskRow mask;
+	fnShiftRow shift;
+	fnEncodeTile8x8 encodeTile8x8;
+	fnDecodeTile8x8 decodeTile8x8;
+};
+
+static const int kPixelFormatCount = static_cast< int >( PixelFormat::NES ) + 1;
+
+static BoundKernels gKernels[ kPixelFormatCount ];
+static fnWidenRow gWidenRow = nullptr;
+static bool gbKernelsBound = false;
+
+static const BoundKernels& getKernels( PixelFormat format )
+{
+	if ( gbKernelsBound == false )
+	{
+		BindRowKernels();
+	}
+
+	return gKernels[ static_cast< int >( format ) ];
+}
+
+//------------------------------------------------------------------------------
+// BindRowKernels
+//------------------------------------------------------------------------------
+void BindRowKernels()
+{
+	const CpuFeatures& cpu = GetCpuFeatures();
+
+	for ( int i = 0; i < kPixelFormatCount; ++i )
+	{
+		const PixelFormat format = static_cast< PixelFormat >( i );
+
+		gKernels[ i ].pack = selectPackRow( format, cpu );
+		gKernels[ i ].unpack = selectUnpackRow( format, cpu );
+		gKernels[ i ].mask = selectMaskRow( format, cpu );
+		gKernels[ i ].shift = selectShiftRow( format );
+		gKernels[ i ].encodeTile8x8 = selectEncodeTile8x8( format, cpu );
+		gKernels[ i ].decodeTile8x8 = selectDecodeTile8x8( format, cpu );
+	}
+
+	gWidenRow = selectWidenRow( cpu );
+
+	gbKernelsBound = true;
+}
+
+//------------------------------------------------------------------------------
+// GetPackRowKernel
+//------------------------------------------------------------------------------
+fnPackRow GetPackRowKernel( PixelFormat format )
+{
+	return getKernels( format ).pack;
+}
+
+//------------------------------------------------------------------------------
+// GetUnpackRowKernel
+//------------------------------------------------------------------------------
+fnUnpackRow GetUnpackRowKernel( PixelFormat format )
+{
+	return getKernels( format ).unpack;
+}
+
+//------------------------------------------------------------------------------
+// GetMaskRowKernel
+//------------------------------------------------------------------------------
+fnMaskRow GetMaskRowKernel( PixelFormat format )
+{
+	return getKernels( format ).mask;
+}
+
+//------------------------------------------------------------------------------
+// GetShiftRowKernel
+//------------------------------------------------------------------------------
+fnShiftRow GetShiftRowKernel( PixelFormat format )
+{
+	return getKernels( format ).shift;
+}
+
+//------------------------------------------------------------------------------
+// GetEncodeTile8x8Kernel
+//------------------------------------------------------------------------------
+fnEncodeTile8x8 GetEncodeTile8x8Kernel( PixelFormat format )
+{
+	return getKernels( format ).encodeTile8x8;
+}
+
+//------------------------------------------------------------------------------
+// GetDecodeTile8x8Kernel
+//------------------------------------------------------------------------------
+fnDecodeTile8x8 GetDecodeTile8x8Kernel( PixelFormat format )
+{
+	return getKernels( format ).decodeTile8x8;
+}
+
+//------------------------------------------------------------------------------
+// GetWidenRowKernel
+//------------------------------------------------------------------------------
+fnWidenRow GetWidenRowKernel()
+{
+	if ( gbKernelsBound == false )
+	{
+		BindRowKernels();
+	}
+
+	return gWidenRow;
+}
+
+//==============================================================================
@@ -0,0 +1,97 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "PixelFormat.h"
+
+class IndexSet;
+
+// Row conversion kernels.
+//
+// A pack kernel converts 'count' CHUNKY_8 indices into the native row layout of
+// a pixel format. An unpack kernel does the reverse. Excess index bits are
+// ignored, exactly as Image::Plot does. If 'count' doesn't fill the last byte
+// or block, the remaining pixels are packed as index zero.
+//
+// Image::Plot and Image::Peek are the per-pixel reference for these kernels.
+
+typedef void ( *fnPackRow )( const uint8_t* pSrc8, int count, uint8_t* pDst );
+typedef void ( *fnUnpackRow )( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+
+// Mask kernel. Tests 'count' CHUNKY_8 indices for membership of 'set' and packs the
+// result into the native row layout: a member is packed as index 255 and anything
+// else as index 0, or the other way round if bInvert is set. Pixels that pad the
+// last byte or block are tested as index zero, like the image border.
+
+typedef void ( *fnMaskRow )( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+
+// Shift kernel. Writes a packed row of 'count' pixels to pDst shifted right by
+// 'shift' pixels, making a row of count + shift pixels. The pixels revealed on the
+// left, and any padding in the last byte or block, are border: pFill is one unit
+// packed with the border index. pSrc and pDst must not overlap.
+
+typedef void ( *fnShiftRow )( const uint8_t* pSrc, int count, int shift, const uint8_t* pFill, uint8_t* pDst );
+
+// Tile kernel for 8x8 pattern formats (see PixelFormatIsPattern8x8).
+//
+// Encodes an 8x8 block of CHUNKY_8 indices, with rows 'srcPitch' bytes apart,
+// into one contiguous pattern: 16 bytes for NES and Game Boy, 32 bytes for
+// Master System.
+
+typedef void ( *fnEncodeTile8x8 )( const uint8_t* pSrc8, int srcPitch, uint8_t* pDst );
+
+// The reverse: decode one pattern into an 8x8 block of CHUNKY_8 indices.
+typedef void ( *fnDecodeTile8x8 )( const uint8_t* pSrc, uint8_t* pDst8, int dstPitch );
+
+// Widen kernel. Repeats each of the first 'count' CHUNKY_8 pixels in pRow 'scale'
+// times, in place, making a row of count * scale pixels.
+
+typedef void ( *fnWidenRow )( uint8_t* pRow, int count, int scale );
+
+// Bind the fastest kernels for each pixel format, as limited by GetCpuFeatures.
+// Runs automatically on first use. Call it again after LimitCpuFeatures.
+void BindRowKernels();
+
+// Get the pack kernel for a pixel format. Returns nullptr for UNKNOWN.
+fnPackRow GetPackRowKernel( PixelFormat format );
+
+// Get the unpack kernel for a pixel format. Returns nullptr for UNKNOWN.
+fnUnpackRow GetUnpackRowKernel( PixelFormat format );
+
+// Get the mask kernel for a pixel format. Returns nullptr for UNKNOWN.
+fnMaskRow GetMaskRowKernel( PixelFormat format );
+
+// Get the shift kernel for a pixel format. Returns nullptr for UNKNOWN, and for the
+// pattern formats, which can't be shifted.
+fnShiftRow GetShiftRowKernel( PixelFormat format );
+
+// Get the tile kernels for a pixel format. Return nullptr if it's not a pattern format.
+fnEncodeTile8x8 GetEncodeTile8x8Kernel( PixelFormat format );
+fnDecodeTile8x8 GetDecodeTile8x8Kernel( PixelFormat format );
+
+// Get the widen kernel. It works on CHUNKY_8 rows only.
+fnWidenRow GetWidenRowKernel();
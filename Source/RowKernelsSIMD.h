@@ -0,0 +1,121 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+
+class IndexSet;
+
+// SIMD variants of the row kernels. These are bound at run-time by
+// BindRowKernels, never called directly.
+//
+// RowKernels_SSE2.cpp is built with the default x64 instruction set.
+// RowKernels_AVX2.cpp must be built with AVX2 enabled (/arch:AVX2 or -mavx2).
+// RowKernels_AVX512.cpp must be built with AVX-512 enabled (/arch:AVX512 or
+// -mavx512f -mavx512bw -mavx512vl).
+// RowKernels_BMI2.cpp needs -mbmi2 on GCC/Clang. MSVC has no switch for BMI2.
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#define ROW_KERNELS_X64 1
+#endif
+
+#ifdef ROW_KERNELS_X64
+
+//
+// -- SSE2
+
+void PackRow_1bpp_SSE2( const uint8_t* pSrc8, int count, uint8_t* pDst );
+void PackRow_ST0_SSE2( const uint8_t* pSrc8, int count, uint8_t* pDst );
+void PackRow_ST1_SSE2( const uint8_t* pSrc8, int count, uint8_t* pDst );
+void PackRow_ST2_SSE2( const uint8_t* pSrc8, int count, uint8_t* pDst );
+
+void EncodeTile8x8_SMS_SSE2( const uint8_t* pSrc8, int srcPitch, uint8_t* pDst );
+void EncodeTile8x8_GB_SSE2( const uint8_t* pSrc8, int srcPitch, uint8_t* pDst );
+void EncodeTile8x8_NES_SSE2( const uint8_t* pSrc8, int srcPitch, uint8_t* pDst );
+
+void UnpackRow_1bpp_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_2bpp_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_4bpp_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_Chunky16_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_Chunky32_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_ST0_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_ST1_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_ST2_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_SMS_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_GB_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_NES_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+
+void DecodeTile8x8_SMS_SSE2( const uint8_t* pSrc, uint8_t* pDst8, int dstPitch );
+void DecodeTile8x8_GB_SSE2( const uint8_t* pSrc, uint8_t* pDst8, int dstPitch );
+void DecodeTile8x8_NES_SSE2( const uint8_t* pSrc, uint8_t* pDst8, int dstPitch );
+
+void MaskRow_1bpp_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_ST0_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_ST1_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_ST2_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_SMS_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_GB_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_NES_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+
+void WidenRow_SSE2( uint8_t* pRow, int count, int scale );
+
+//
+// -- AVX2
+
+void PackRow_1bpp_AVX2( const uint8_t* pSrc8, int count, uint8_t* pDst );
+void PackRow_ST0_AVX2( const uint8_t* pSrc8, int count, uint8_t* pDst );
+void PackRow_ST1_AVX2( const uint8_t* pSrc8, int count, uint8_t* pDst );
+void PackRow_ST2_AVX2( const uint8_t* pSrc8, int count, uint8_t* pDst );
+
+void UnpackRow_1bpp_AVX2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_ST0_AVX2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_ST1_AVX2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+void UnpackRow_ST2_AVX2( const uint8_t* pSrc, int count, uint8_t* pDst8 );
+
+void MaskRow_1bpp_AVX2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_ST0_AVX2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_ST1_AVX2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_ST2_AVX2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+
+//
+// -- AVX-512 (F + BW + VL)
+
+void PackRow_1bpp_AVX512( const uint8_t* pSrc8, int count, uint8_t* pDst );
+void PackRow_ST0_AVX512( const uint8_t* pSrc8, int count, uint8_t* pDst );
+void PackRow_ST1_AVX512( const uint8_t* pSrc8, int count, uint8_t* pDst );
+void PackRow_ST2_AVX512( const uint8_t* pSrc8, int count, uint8_t* pDst );
+
+void MaskRow_1bpp_AVX512( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_ST0_AVX512( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_ST1_AVX512( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+void MaskRow_ST2_AVX512( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst );
+
+//
+// -- BMI2
+
+void PackRow_Cpc0_BMI2( const uint8_t* pSrc8, int count, uint8_t* pDst );
+void PackRow_Cpc1_BMI2( const uint8_t* pSrc8, int count, uint8_t* pDst );
+
+#endif // ROW_KERNELS_X64
@@ -0,0 +1,316 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "RowKernelsSIMD.h"
+#include "IndexSet.h"
+
+#ifdef ROW_KERNELS_X64
+
+#include <immintrin.h>
+#include <cstring>
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+// Reverse the pixels in each group of 8, so movemask gives MSB = left.
+static inline __m256i reverseGroupsOf8( __m256i v )
+{
+	const __m256i reverse = _mm256_setr_epi8( 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+											  7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 );
+
+	return _mm256_shuffle_epi8( v, reverse );
+}
+
+// Gather index bit K of 32 reversed pixels into four MSB-left bytes.
+template< int K >
+static inline uint32_t gatherPlane( __m256i reversed )
+{
+	// ... move index bit K to the top of each byte, then gather.
+	return static_cast< uint32_t >( _mm256_movemask_epi8( _mm256_slli_epi16( reversed, 7 - K ) ) );
+}
+
+// Store one gathered plane of two adjacent 16-pixel ST blocks.
+template< int PLANES, int K >
+static inline void storePlaneST( uint32_t bits, uint8_t* pDst )
+{
+	const uint16_t lo = static_cast< uint16_t >( bits );
+	const uint16_t hi = static_cast< uint16_t >( bits >> 16 );
+
+	memcpy( pDst + K * 2, &lo, 2 );
+	memcpy( pDst + PLANES * 2 + K * 2, &hi, 2 );
+}
+
+template< int PLANES >
+static void packRowST( const uint8_t* pSrc8, int count, uint8_t* pDst, void ( *tailFn )( const uint8_t*, int, uint8_t* ) )
+{
+	for ( ; count >= 32; count -= 32 )
+	{
+		__m256i v = reverseGroupsOf8( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( pSrc8 ) ) );
+
+		// Two blocks at once. Each word is already in big-endian byte order.
+		storePlaneST< PLANES, 0 >( gatherPlane< 0 >( v ), pDst );
+		if ( PLANES > 1 ) storePlaneST< PLANES, 1 >( gatherPlane< 1 >( v ), pDst );
+		if ( PLANES > 2 ) storePlaneST< PLANES, 2 >( gatherPlane< 2 >( v ), pDst );
+		if ( PLANES > 3 ) storePlaneST< PLANES, 3 >( gatherPlane< 3 >( v ), pDst );
+
+		pSrc8 += 32;
+		pDst += PLANES * 4;
+	}
+
+	// ... tail, up to 31 pixels.
+	tailFn( pSrc8, count, pDst );
+}
+
+// Spread 32 bits, MSB-left bytes, to 32 bytes: 0xFF where the bit is set.
+static inline __m256i expandBits32( uint32_t bits )
+{
+	const __m256i spread = _mm256_setr_epi8( 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+											 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 );
+	const __m256i select = _mm256_setr_epi8( -128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1,
+											 -128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1 );
+
+	const __m256i v = _mm256_shuffle_epi8( _mm256_set1_epi32( static_cast< int >( bits ) ), spread );
+
+	return _mm256_cmpeq_epi8( _mm256_and_si256( v, select ), select );
+}
+
+// Load one plane of two adjacent 16-pixel ST blocks.
+template< int PLANES, int K >
+static inline __m256i loadPlaneST( const uint8_t* pSrc )
+{
+	uint16_t lo, hi;
+	memcpy( &lo, pSrc + K * 2, 2 );
+	memcpy( &hi, pSrc + PLANES * 2 + K * 2, 2 );
+
+	return _mm256_and_si256( expandBits32( lo | ( static_cast< uint32_t >( hi ) << 16 ) ), _mm256_set1_epi8( 1 << K ) );
+}
+
+template< int PLANES >
+static void unpackRowST( const uint8_t* pSrc, int count, uint8_t* pDst8, void ( *tailFn )( const uint8_t*, int, uint8_t* ) )
+{
+	for ( ; count >= 32; count -= 32 )
+	{
+		__m256i index = loadPlaneST< PLANES, 0 >( pSrc );
+		if ( PLANES > 1 ) index = _mm256_or_si256( index, loadPlaneST< PLANES, 1 >( pSrc ) );
+		if ( PLANES > 2 ) index = _mm256_or_si256( index, loadPlaneST< PLANES, 2 >( pSrc ) );
+		if ( PLANES > 3 ) index = _mm256_or_si256( index, loadPlaneST< PLANES, 3 >( pSrc ) );
+
+		_mm256_storeu_si256( reinterpret_cast< __m256i* >( pDst8 ), index );
+
+		pSrc += PLANES * 4;
+		pDst8 += 32;
+	}
+
+	// ... tail, up to 31 pixels.
+	tailFn( pSrc, count, pDst8 );
+}
+
+typedef void ( *fnMaskTail )( const uint8_t*, int, const IndexSet&, bool, uint8_t* );
+
+// Membership test for 32 indices: two nibble lookups pick the bitmap byte, a third
+// picks the bit within it.
+struct MatchSet32
+{
+	__m256i bitmapLo; // bitmap bytes 0 - 15, in both lanes
+	__m256i bitmapHi; // bitmap bytes 16 - 31, in both lanes
+	__m256i invert;
+
+	MatchSet32( const IndexSet& set, bool bInvert ) :
+
+		bitmapLo( _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast< const __m128i* >( set.GetBitmap() ) ) ) ),
+		bitmapHi( _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast< const __m128i* >( set.GetBitmap() + 16 ) ) ) ),
+		invert( _mm256_set1_epi8( bInvert ? -1 : 0 ) )
+
+	{
+		//
+	}
+
+	// Test 32 indices, and gather the result into four MSB-left bytes.
+	uint32_t operator()( const uint8_t* pSrc8 ) const
+	{
+		const __m256i bit = _mm256_setr_epi8( 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+											  1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128 );
+
+		const __m256i v = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( pSrc8 ) );
+
+		// ... bitmap byte (index >> 3), then the bit (index & 7) within it.
+		const __m256i byteIndex = _mm256_and_si256( _mm256_srli_epi16( v, 3 ), _mm256_set1_epi8( 0x1F ) );
+		const __m256i bHigh = _mm256_cmpgt_epi8( byteIndex, _mm256_set1_epi8( 15 ) );
+		const __m256i bytes = _mm256_blendv_epi8( _mm256_shuffle_epi8( bitmapLo, byteIndex ), _mm256_shuffle_epi8( bitmapHi, byteIndex ), bHigh );
+		const __m256i bits = _mm256_shuffle_epi8( bit, _mm256_and_si256( v, _mm256_set1_epi8( 7 ) ) );
+
+		const __m256i match = _mm256_xor_si256( _mm256_cmpeq_epi8( _mm256_and_si256( bytes, bits ), bits ), invert );
+
+		return static_cast< uint32_t >( _mm256_movemask_epi8( reverseGroupsOf8( match ) ) );
+	}
+};
+
+template< int PLANES >
+static void maskRowST( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst, fnMaskTail tailFn )
+{
+	const MatchSet32 match( set, bInvert );
+
+	for ( ; count >= 32; count -= 32 )
+	{
+		// Every plane of each block is the same word.
+		const uint32_t bits = match( pSrc8 );
+
+		storePlaneST< PLANES, 0 >( bits, pDst );
+		if ( PLANES > 1 ) storePlaneST< PLANES, 1 >( bits, pDst );
+		if ( PLANES > 2 ) storePlaneST< PLANES, 2 >( bits, pDst );
+		if ( PLANES > 3 ) storePlaneST< PLANES, 3 >( bits, pDst );
+
+		pSrc8 += 32;
+		pDst += PLANES * 4;
+	}
+
+	// ... tail, up to 31 pixels.
+	tailFn( pSrc8, count, set, bInvert, pDst );
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// PackRow_1bpp_AVX2
+//------------------------------------------------------------------------------
+void PackRow_1bpp_AVX2( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	for ( ; count >= 32; count -= 32 )
+	{
+		__m256i v = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( pSrc8 ) );
+		const uint32_t bits = gatherPlane< 0 >( reverseGroupsOf8( v ) );
+
+		memcpy( pDst, &bits, sizeof( bits ) );
+
+		pSrc8 += 32;
+		pDst += 4;
+	}
+
+	// ... tail, up to 31 pixels.
+	PackRow_1bpp_SSE2( pSrc8, count, pDst );
+}
+
+//------------------------------------------------------------------------------
+// PackRow_ST0_AVX2 / PackRow_ST1_AVX2 / PackRow_ST2_AVX2
+//------------------------------------------------------------------------------
+void PackRow_ST0_AVX2( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	packRowST< 4 >( pSrc8, count, pDst, PackRow_ST0_SSE2 );
+}
+
+void PackRow_ST1_AVX2( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	packRowST< 2 >( pSrc8, count, pDst, PackRow_ST1_SSE2 );
+}
+
+void PackRow_ST2_AVX2( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	packRowST< 1 >( pSrc8, count, pDst, PackRow_ST2_SSE2 );
+}
+
+//------------------------------------------------------------------------------
+// UnpackRow_1bpp_AVX2
+//------------------------------------------------------------------------------
+void UnpackRow_1bpp_AVX2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	const __m256i one = _mm256_set1_epi8( 1 );
+
+	for ( ; count >= 32; count -= 32 )
+	{
+		uint32_t bits;
+		memcpy( &bits, pSrc, sizeof( bits ) );
+
+		_mm256_storeu_si256( reinterpret_cast< __m256i* >( pDst8 ), _mm256_and_si256( expandBits32( bits ), one ) );
+
+		pSrc += 4;
+		pDst8 += 32;
+	}
+
+	// ... tail, up to 31 pixels.
+	UnpackRow_1bpp_SSE2( pSrc, count, pDst8 );
+}
+
+//------------------------------------------------------------------------------
+// UnpackRow_ST0_AVX2 / UnpackRow_ST1_AVX2 / UnpackRow_ST2_AVX2
+//------------------------------------------------------------------------------
+void UnpackRow_ST0_AVX2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowST< 4 >( pSrc, count, pDst8, UnpackRow_ST0_SSE2 );
+}
+
+void UnpackRow_ST1_AVX2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowST< 2 >( pSrc, count, pDst8, UnpackRow_ST1_SSE2 );
+}
+
+void UnpackRow_ST2_AVX2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowST< 1 >( pSrc, count, pDst8, UnpackRow_ST2_SSE2 );
+}
+
+//------------------------------------------------------------------------------
+// MaskRow_1bpp_AVX2
+//------------------------------------------------------------------------------
+void MaskRow_1bpp_AVX2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	const MatchSet32 match( set, bInvert );
+
+	for ( ; count >= 32; count -= 32 )
+	{
+		const uint32_t bits = match( pSrc8 );
+
+		memcpy( pDst, &bits, sizeof( bits ) );
+
+		pSrc8 += 32;
+		pDst += 4;
+	}
+
+	// ... tail, up to 31 pixels.
+	MaskRow_1bpp_SSE2( pSrc8, count, set, bInvert, pDst );
+}
+
+//------------------------------------------------------------------------------
+// MaskRow_ST0_AVX2 / MaskRow_ST1_AVX2 / MaskRow_ST2_AVX2
+//------------------------------------------------------------------------------
+void MaskRow_ST0_AVX2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowST< 4 >( pSrc8, count, set, bInvert, pDst, MaskRow_ST0_SSE2 );
+}
+
+void MaskRow_ST1_AVX2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowST< 2 >( pSrc8, count, set, bInvert, pDst, MaskRow_ST1_SSE2 );
+}
+
+void MaskRow_ST2_AVX2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowST< 1 >( pSrc8, count, set, bInvert, pDst, MaskRow_ST2_SSE2 );
+}
+
+//==============================================================================
+
+#endif // ROW_KERNELS_X64
@@ -0,0 +1,228 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "RowKernelsSIMD.h"
+#include "IndexSet.h"
+
+#ifdef ROW_KERNELS_X64
+
+#include <immintrin.h>
+#include <cstring>
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+// Load up to 64 indices. Missing pixels read as index zero.
+static inline __m512i loadPixels( const uint8_t* pSrc8, int count )
+{
+	const __mmask64 valid = ( count >= 64 ) ? ~0ULL : ( ( 1ULL << count ) - 1 );
+	return _mm512_maskz_loadu_epi8( valid, pSrc8 );
+}
+
+// Reverse the pixels in each group of 8, so the gathered bits are MSB = left.
+static inline __m512i reverseGroupsOf8( __m512i v )
+{
+	const __m512i reverse = _mm512_set_epi64( 0x08090A0B0C0D0E0FLL, 0x0001020304050607LL,
+											  0x08090A0B0C0D0E0FLL, 0x0001020304050607LL,
+											  0x08090A0B0C0D0E0FLL, 0x0001020304050607LL,
+											  0x08090A0B0C0D0E0FLL, 0x0001020304050607LL );
+
+	return _mm512_shuffle_epi8( v, reverse );
+}
+
+// Gather index bit K of 64 reversed pixels into eight MSB-left bytes.
+template< int K >
+static inline uint64_t gatherPlane( __m512i reversed )
+{
+	return _mm512_test_epi8_mask( reversed, _mm512_set1_epi8( 1 << K ) );
+}
+
+// Store one gathered plane of up to four adjacent 16-pixel ST blocks.
+template< int PLANES, int K >
+static inline void storePlaneST( uint64_t bits, int blocks, uint8_t* pDst )
+{
+	// Each block's word is already in big-endian byte order.
+	for ( int b = 0; b < blocks; ++b )
+	{
+		const uint16_t word = static_cast< uint16_t >( bits >> ( b * 16 ) );
+		memcpy( pDst + b * PLANES * 2 + K * 2, &word, 2 );
+	}
+}
+
+// Masked loads pad the tail with index zero, so there's no scalar tail.
+template< int PLANES >
+static void packRowST( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	for ( ; count > 0; count -= 64 )
+	{
+		const __m512i v = reverseGroupsOf8( loadPixels( pSrc8, count ) );
+		const int blocks = ( count >= 64 ) ? 4 : ( ( count + 15 ) >> 4 );
+
+		storePlaneST< PLANES, 0 >( gatherPlane< 0 >( v ), blocks, pDst );
+		if ( PLANES > 1 ) storePlaneST< PLANES, 1 >( gatherPlane< 1 >( v ), blocks, pDst );
+		if ( PLANES > 2 ) storePlaneST< PLANES, 2 >( gatherPlane< 2 >( v ), blocks, pDst );
+		if ( PLANES > 3 ) storePlaneST< PLANES, 3 >( gatherPlane< 3 >( v ), blocks, pDst );
+
+		pSrc8 += 64;
+		pDst += PLANES * 8;
+	}
+}
+
+// Membership test for 64 indices: two nibble lookups pick the bitmap byte, a third
+// picks the bit within it.
+struct MatchSet64
+{
+	__m512i bitmapLo; // bitmap bytes 0 - 15, in every lane
+	__m512i bitmapHi; // bitmap bytes 16 - 31, in every lane
+	uint64_t invert;
+
+	MatchSet64( const IndexSet& set, bool bInvert ) :
+
+		bitmapLo( _mm512_broadcast_i32x4( _mm_loadu_si128( reinterpret_cast< const __m128i* >( set.GetBitmap() ) ) ) ),
+		bitmapHi( _mm512_broadcast_i32x4( _mm_loadu_si128( reinterpret_cast< const __m128i* >( set.GetBitmap() + 16 ) ) ) ),
+		invert( bInvert ? ~0ULL : 0 )
+
+	{
+		//
+	}
+
+	// Test up to 64 indices, and gather the result into eight MSB-left bytes.
+	// Missing pixels are tested as index zero.
+	uint64_t operator()( const uint8_t* pSrc8, int count ) const
+	{
+		const __m512i bit = _mm512_set1_epi64( static_cast< long long >( 0x8040201008040201ULL ) );
+
+		const __m512i v = reverseGroupsOf8( loadPixels( pSrc8, count ) );
+
+		// ... bitmap byte (index >> 3), then the bit (index & 7) within it.
+		const __m512i byteIndex = _mm512_and_si512( _mm512_srli_epi16( v, 3 ), _mm512_set1_epi8( 0x1F ) );
+		const __mmask64 bHigh = _mm512_test_epi8_mask( byteIndex, _mm512_set1_epi8( 0x10 ) );
+		const __m512i bytes = _mm512_mask_shuffle_epi8( _mm512_shuffle_epi8( bitmapLo, byteIndex ), bHigh, bitmapHi, byteIndex );
+		const __m512i bits = _mm512_shuffle_epi8( bit, _mm512_and_si512( v, _mm512_set1_epi8( 7 ) ) );
+
+		return _mm512_test_epi8_mask( bytes, bits ) ^ invert;
+	}
+};
+
+template< int PLANES >
+static void maskRowST( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	const MatchSet64 match( set, bInvert );
+
+	for ( ; count > 0; count -= 64 )
+	{
+		// Every plane of each block is the same word.
+		const uint64_t bits = match( pSrc8, count );
+		const int blocks = ( count >= 64 ) ? 4 : ( ( count + 15 ) >> 4 );
+
+		storePlaneST< PLANES, 0 >( bits, blocks, pDst );
+		if ( PLANES > 1 ) storePlaneST< PLANES, 1 >( bits, blocks, pDst );
+		if ( PLANES > 2 ) storePlaneST< PLANES, 2 >( bits, blocks, pDst );
+		if ( PLANES > 3 ) storePlaneST< PLANES, 3 >( bits, blocks, pDst );
+
+		pSrc8 += 64;
+		pDst += PLANES * 8;
+	}
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// PackRow_1bpp_AVX512
+//------------------------------------------------------------------------------
+void PackRow_1bpp_AVX512( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	for ( ; count > 0; count -= 64 )
+	{
+		const uint64_t bits = gatherPlane< 0 >( reverseGroupsOf8( loadPixels( pSrc8, count ) ) );
+		const int bytes = ( count >= 64 ) ? 8 : ( ( count + 7 ) >> 3 );
+
+		memcpy( pDst, &bits, bytes );
+
+		pSrc8 += 64;
+		pDst += 8;
+	}
+}
+
+//------------------------------------------------------------------------------
+// PackRow_ST0_AVX512 / PackRow_ST1_AVX512 / PackRow_ST2_AVX512
+//------------------------------------------------------------------------------
+void PackRow_ST0_AVX512( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	packRowST< 4 >( pSrc8, count, pDst );
+}
+
+void PackRow_ST1_AVX512( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	packRowST< 2 >( pSrc8, count, pDst );
+}
+
+void PackRow_ST2_AVX512( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	packRowST< 1 >( pSrc8, count, pDst );
+}
+
+//------------------------------------------------------------------------------
+// MaskRow_1bpp_AVX512
+//------------------------------------------------------------------------------
+void MaskRow_1bpp_AVX512( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	const MatchSet64 match( set, bInvert );
+
+	for ( ; count > 0; count -= 64 )
+	{
+		const uint64_t bits = match( pSrc8, count );
+		const int bytes = ( count >= 64 ) ? 8 : ( ( count + 7 ) >> 3 );
+
+		memcpy( pDst, &bits, bytes );
+
+		pSrc8 += 64;
+		pDst += 8;
+	}
+}
+
+//------------------------------------------------------------------------------
+// MaskRow_ST0_AVX512 / MaskRow_ST1_AVX512 / MaskRow_ST2_AVX512
+//------------------------------------------------------------------------------
+void MaskRow_ST0_AVX512( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowST< 4 >( pSrc8, count, set, bInvert, pDst );
+}
+
+void MaskRow_ST1_AVX512( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowST< 2 >( pSrc8, count, set, bInvert, pDst );
+}
+
+void MaskRow_ST2_AVX512( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowST< 1 >( pSrc8, count, set, bInvert, pDst );
+}
+
+//==============================================================================
+
+#endif // ROW_KERNELS_X64
@@ -0,0 +1,134 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "RowKernelsSIMD.h"
+
+#ifdef ROW_KERNELS_X64
+
+#include <immintrin.h>
+#include <cstring>
+
+#if defined( _MSC_VER )
+#include <stdlib.h>
+#define bswap32( x ) _byteswap_ulong( x )
+#define bswap64( x ) _byteswap_uint64( x )
+#else
+#define bswap32( x ) __builtin_bswap32( x )
+#define bswap64( x ) __builtin_bswap64( x )
+#endif
+
+//==============================================================================
+
+// Both packers work on 8 pixels at a time, loaded as one 64-bit word and byte
+// swapped so that pixel 0 is in the top byte. PEXT then gathers one index bit of
+// every pixel into a byte, MSB = pixel 0, and PDEP scatters it to its place in
+// the output. The lowest PDEP bits land in the first output byte, so the result
+// is byte swapped once more before it's stored.
+
+// Index bit 0 of every pixel.
+static const uint64_t kPlane0 = 0x0101010101010101ULL;
+
+//------------------------------------------------------------------------------
+// AMSTRAD_CPC_M0 - 8 pixels => 4 bytes.
+//------------------------------------------------------------------------------
+
+// Destination of index bit K for a pair of pixels, in each output byte.
+// See gCpc0Bit in RowKernels.cpp: pixel 0 at bits { 7, 3, 5, 1 }, pixel 1 one lower.
+static const uint32_t kCpc0Deposit[ 4 ] = { 0xC0C0C0C0, 0x0C0C0C0C, 0x30303030, 0x03030303 };
+
+static inline void packCpc0x8( const uint8_t* pSrc8, uint8_t* pDst )
+{
+	uint64_t v;
+	memcpy( &v, pSrc8, sizeof( v ) );
+	v = bswap64( v );
+
+	uint32_t out = 0;
+	for ( int k = 0; k < 4; ++k )
+	{
+		out |= static_cast< uint32_t >( _pdep_u64( _pext_u64( v, kPlane0 << k ), kCpc0Deposit[ k ] ) );
+	}
+
+	out = bswap32( out );
+	memcpy( pDst, &out, sizeof( out ) );
+}
+
+void PackRow_Cpc0_BMI2( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	for ( ; count >= 8; count -= 8 )
+	{
+		packCpc0x8( pSrc8, pDst );
+		pSrc8 += 8;
+		pDst += 4;
+	}
+
+	if ( count > 0 )
+	{
+		uint8_t tail[ 8 ] = {};
+		uint8_t out[ 4 ];
+		memcpy( tail, pSrc8, count );
+		packCpc0x8( tail, out );
+		memcpy( pDst, out, ( count + 1 ) >> 1 );
+	}
+}
+
+//------------------------------------------------------------------------------
+// AMSTRAD_CPC_M1 - 8 pixels => 2 bytes.
+//------------------------------------------------------------------------------
+
+static inline void packCpc1x8( const uint8_t* pSrc8, uint8_t* pDst )
+{
+	uint64_t v;
+	memcpy( &v, pSrc8, sizeof( v ) );
+	v = bswap64( v );
+
+	// ... bit 0 in the high nibble, bit 1 in the low.
+	uint32_t out = static_cast< uint32_t >( _pdep_u64( _pext_u64( v, kPlane0 ), 0xF0F0 ) |
+											_pdep_u64( _pext_u64( v, kPlane0 << 1 ), 0x0F0F ) );
+
+	pDst[ 0 ] = static_cast< uint8_t >( out >> 8 );
+	pDst[ 1 ] = static_cast< uint8_t >( out );
+}
+
+void PackRow_Cpc1_BMI2( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	for ( ; count >= 8; count -= 8 )
+	{
+		packCpc1x8( pSrc8, pDst );
+		pSrc8 += 8;
+		pDst += 2;
+	}
+
+	if ( count > 0 )
+	{
+		uint8_t tail[ 8 ] = {};
+		uint8_t out[ 2 ];
+		memcpy( tail, pSrc8, count );
+		packCpc1x8( tail, out );
+		memcpy( pDst, out, ( count + 3 ) >> 2 );
+	}
+}
+
+//==============================================================================
+
+#endif // ROW_KERNELS_X64
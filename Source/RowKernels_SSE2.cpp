@@ -0,0 +1,710 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "RowKernelsSIMD.h"
+#include "IndexSet.h"
+
+#ifdef ROW_KERNELS_X64
+
+#include <emmintrin.h>
+#include <cstring>
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+// Reverse the pixels in each group of 8, so movemask gives MSB = left.
+static inline __m128i reverseGroupsOf8( __m128i v )
+{
+	v = _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+	v = _mm_shufflelo_epi16( v, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+	v = _mm_shufflehi_epi16( v, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+	return v;
+}
+
+// Gather index bit K of 16 reversed pixels into two MSB-left bytes.
+template< int K >
+static inline uint16_t gatherPlane( __m128i reversed )
+{
+	// ... move index bit K to the top of each byte, then gather.
+	return static_cast< uint16_t >( _mm_movemask_epi8( _mm_slli_epi16( reversed, 7 - K ) ) );
+}
+
+// Encode 16 indices as PLANES big-endian Atari ST plane words. This is a bit-matrix
+// transpose: one shift + movemask per plane.
+template< int PLANES >
+static inline void encodeBlockST( __m128i v, uint8_t* pDst )
+{
+	v = reverseGroupsOf8( v );
+
+	uint16_t words[ 4 ];
+	words[ 0 ] = gatherPlane< 0 >( v );
+	if ( PLANES > 1 ) words[ 1 ] = gatherPlane< 1 >( v );
+	if ( PLANES > 2 ) words[ 2 ] = gatherPlane< 2 >( v );
+	if ( PLANES > 3 ) words[ 3 ] = gatherPlane< 3 >( v );
+
+	// Each word is already in big-endian byte order.
+	memcpy( pDst, words, PLANES * 2 );
+}
+
+template< int PLANES >
+static void packRowST( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	for ( ; count >= 16; count -= 16 )
+	{
+		encodeBlockST< PLANES >( _mm_loadu_si128( reinterpret_cast< const __m128i* >( pSrc8 ) ), pDst );
+
+		pSrc8 += 16;
+		pDst += PLANES * 2;
+	}
+
+	// ... partial block, padded with index zero.
+	if ( count > 0 )
+	{
+		uint8_t tail[ 16 ] = {};
+		memcpy( tail, pSrc8, count );
+		encodeBlockST< PLANES >( _mm_loadu_si128( reinterpret_cast< const __m128i* >( tail ) ), pDst );
+	}
+}
+
+// Gather all 8 rows of plane K of a pattern into one vector, one byte per row.
+template< int K >
+static inline __m128i gatherPatternPlane( const __m128i rows[ 4 ] )
+{
+	__m128i plane = _mm_setzero_si128();
+	plane = _mm_insert_epi16( plane, gatherPlane< K >( rows[ 0 ] ), 0 );
+	plane = _mm_insert_epi16( plane, gatherPlane< K >( rows[ 1 ] ), 1 );
+	plane = _mm_insert_epi16( plane, gatherPlane< K >( rows[ 2 ] ), 2 );
+	plane = _mm_insert_epi16( plane, gatherPlane< K >( rows[ 3 ] ), 3 );
+	return plane;
+}
+
+// Load an 8x8 pattern as four pairs of reversed rows.
+static inline void loadPattern( const uint8_t* pSrc8, int srcPitch, __m128i rows[ 4 ] )
+{
+	for ( int i = 0; i < 4; ++i )
+	{
+		const __m128i r0 = _mm_loadl_epi64( reinterpret_cast< const __m128i* >( pSrc8 ) );
+		const __m128i r1 = _mm_loadl_epi64( reinterpret_cast< const __m128i* >( pSrc8 + srcPitch ) );
+
+		rows[ i ] = reverseGroupsOf8( _mm_unpacklo_epi64( r0, r1 ) );
+		pSrc8 += srcPitch * 2;
+	}
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// PackRow_1bpp_SSE2
+//------------------------------------------------------------------------------
+void PackRow_1bpp_SSE2( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	for ( ; count >= 16; count -= 16 )
+	{
+		__m128i v = _mm_loadu_si128( reinterpret_cast< const __m128i* >( pSrc8 ) );
+		const uint16_t bits = gatherPlane< 0 >( reverseGroupsOf8( v ) );
+
+		memcpy( pDst, &bits, sizeof( bits ) );
+
+		pSrc8 += 16;
+		pDst += 2;
+	}
+
+	// ... tail, up to 15 pixels.
+	while ( count > 0 )
+	{
+		uint8_t b = 0;
+		for ( int i = 0; i < 8 && i < count; ++i )
+		{
+			b |= ( pSrc8[ i ] & 1 ) << ( 7 - i );
+		}
+		*pDst++ = b;
+
+		pSrc8 += 8;
+		count -= 8;
+	}
+}
+
+//------------------------------------------------------------------------------
+// PackRow_ST0_SSE2 / PackRow_ST1_SSE2 / PackRow_ST2_SSE2
+//------------------------------------------------------------------------------
+void PackRow_ST0_SSE2( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	packRowST< 4 >( pSrc8, count, pDst );
+}
+
+void PackRow_ST1_SSE2( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	packRowST< 2 >( pSrc8, count, pDst );
+}
+
+void PackRow_ST2_SSE2( const uint8_t* pSrc8, int count, uint8_t* pDst )
+{
+	packRowST< 1 >( pSrc8, count, pDst );
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+// EncodeTile8x8_SMS_SSE2
+//------------------------------------------------------------------------------
+void EncodeTile8x8_SMS_SSE2( const uint8_t* pSrc8, int srcPitch, uint8_t* pDst )
+{
+	__m128i rows[ 4 ];
+	loadPattern( pSrc8, srcPitch, rows );
+
+	// Interleave the planes: 4 bytes per row.
+	const __m128i p01 = _mm_unpacklo_epi8( gatherPatternPlane< 0 >( rows ), gatherPatternPlane< 1 >( rows ) );
+	const __m128i p23 = _mm_unpacklo_epi8( gatherPatternPlane< 2 >( rows ), gatherPatternPlane< 3 >( rows ) );
+
+	_mm_storeu_si128( reinterpret_cast< __m128i* >( pDst ), _mm_unpacklo_epi16( p01, p23 ) );
+	_mm_storeu_si128( reinterpret_cast< __m128i* >( pDst + 16 ), _mm_unpackhi_epi16( p01, p23 ) );
+}
+
+//------------------------------------------------------------------------------
+// EncodeTile8x8_GB_SSE2
+//------------------------------------------------------------------------------
+void EncodeTile8x8_GB_SSE2( const uint8_t* pSrc8, int srcPitch, uint8_t* pDst )
+{
+	__m128i rows[ 4 ];
+	loadPattern( pSrc8, srcPitch, rows );
+
+	// Interleave the planes: 2 bytes per row.
+	const __m128i p01 = _mm_unpacklo_epi8( gatherPatternPlane< 0 >( rows ), gatherPatternPlane< 1 >( rows ) );
+
+	_mm_storeu_si128( reinterpret_cast< __m128i* >( pDst ), p01 );
+}
+
+//------------------------------------------------------------------------------
+// EncodeTile8x8_NES_SSE2
+//------------------------------------------------------------------------------
+void EncodeTile8x8_NES_SSE2( const uint8_t* pSrc8, int srcPitch, uint8_t* pDst )
+{
+	__m128i rows[ 4 ];
+	loadPattern( pSrc8, srcPitch, rows );
+
+	// Plane 0 for all rows, then plane 1 for all rows.
+	const __m128i p01 = _mm_unpacklo_epi64( gatherPatternPlane< 0 >( rows ), gatherPatternPlane< 1 >( rows ) );
+
+	_mm_storeu_si128( reinterpret_cast< __m128i* >( pDst ), p01 );
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// Unpack Helpers
+//------------------------------------------------------------------------------
+
+// Spread 16 bits, MSB-left bytes, to 16 bytes: 0xFF where the bit is set.
+static inline __m128i expandBits16( uint32_t bits )
+{
+	const __m128i select = _mm_setr_epi8( -128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1 );
+
+	// ... copy each byte across 8 lanes.
+	__m128i v = _mm_cvtsi32_si128( static_cast< int >( bits ) );
+	v = _mm_unpacklo_epi8( v, v );
+	v = _mm_unpacklo_epi16( v, v );
+	v = _mm_unpacklo_epi32( v, v );
+
+	return _mm_cmpeq_epi8( _mm_and_si128( v, select ), select );
+}
+
+// Store 16 indices, or just the first 'count' of them.
+static inline void storeIndices( __m128i v, int count, uint8_t* pDst8 )
+{
+	if ( count >= 16 )
+	{
+		_mm_storeu_si128( reinterpret_cast< __m128i* >( pDst8 ), v );
+	}
+	else
+	{
+		uint8_t tail[ 16 ];
+		_mm_storeu_si128( reinterpret_cast< __m128i* >( tail ), v );
+		memcpy( pDst8, tail, count );
+	}
+}
+
+// Run a vector unpacker over a row. UNPACK turns 16 source bytes into OUT indices.
+// The last part is unpacked from a zero-padded copy, so nothing is read past the
+// end of the row.
+template< int BITS, int OUT, void ( *UNPACK )( __m128i, uint8_t* ) >
+static inline void unpackRowBytes( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	for ( ; count >= OUT; count -= OUT )
+	{
+		UNPACK( _mm_loadu_si128( reinterpret_cast< const __m128i* >( pSrc ) ), pDst8 );
+		pSrc += 16;
+		pDst8 += OUT;
+	}
+
+	if ( count > 0 )
+	{
+		uint8_t src[ 16 ] = {};
+		uint8_t out[ OUT ];
+		memcpy( src, pSrc, ( count * BITS + 7 ) / 8 );
+		UNPACK( _mm_loadu_si128( reinterpret_cast< const __m128i* >( src ) ), out );
+		memcpy( pDst8, out, count );
+	}
+}
+
+// 16 bytes => 64 x 2-bit pixels.
+static inline void unpack16_2bpp( __m128i v, uint8_t* pDst8 )
+{
+	const __m128i three = _mm_set1_epi8( 3 );
+	const __m128i a = _mm_and_si128( _mm_srli_epi16( v, 6 ), three );
+	const __m128i b = _mm_and_si128( _mm_srli_epi16( v, 4 ), three );
+	const __m128i c = _mm_and_si128( _mm_srli_epi16( v, 2 ), three );
+	const __m128i d = _mm_and_si128( v, three );
+
+	const __m128i abLo = _mm_unpacklo_epi8( a, b ), abHi = _mm_unpackhi_epi8( a, b );
+	const __m128i cdLo = _mm_unpacklo_epi8( c, d ), cdHi = _mm_unpackhi_epi8( c, d );
+
+	__m128i* pOut = reinterpret_cast< __m128i* >( pDst8 );
+	_mm_storeu_si128( pOut + 0, _mm_unpacklo_epi16( abLo, cdLo ) );
+	_mm_storeu_si128( pOut + 1, _mm_unpackhi_epi16( abLo, cdLo ) );
+	_mm_storeu_si128( pOut + 2, _mm_unpacklo_epi16( abHi, cdHi ) );
+	_mm_storeu_si128( pOut + 3, _mm_unpackhi_epi16( abHi, cdHi ) );
+}
+
+// 16 bytes => 32 x 4-bit pixels.
+static inline void unpack16_4bpp( __m128i v, uint8_t* pDst8 )
+{
+	const __m128i nibble = _mm_set1_epi8( 0xF );
+	const __m128i hi = _mm_and_si128( _mm_srli_epi16( v, 4 ), nibble );
+	const __m128i lo = _mm_and_si128( v, nibble );
+
+	__m128i* pOut = reinterpret_cast< __m128i* >( pDst8 );
+	_mm_storeu_si128( pOut + 0, _mm_unpacklo_epi8( hi, lo ) );
+	_mm_storeu_si128( pOut + 1, _mm_unpackhi_epi8( hi, lo ) );
+}
+
+// 16 bytes => 8 x 16-bit pixels, low byte only.
+static inline void unpack16_Chunky16( __m128i v, uint8_t* pDst8 )
+{
+	v = _mm_and_si128( v, _mm_set1_epi16( 0xFF ) );
+	_mm_storel_epi64( reinterpret_cast< __m128i* >( pDst8 ), _mm_packus_epi16( v, v ) );
+}
+
+// 16 bytes => 4 x 32-bit pixels, low byte only.
+static inline void unpack16_Chunky32( __m128i v, uint8_t* pDst8 )
+{
+	v = _mm_and_si128( v, _mm_set1_epi32( 0xFF ) );
+	v = _mm_packs_epi32( v, v );
+	v = _mm_packus_epi16( v, v );
+
+	const int out = _mm_cvtsi128_si32( v );
+	memcpy( pDst8, &out, 4 );
+}
+
+// Unpack a row of 16-pixel Atari ST blocks.
+template< int PLANES >
+static void unpackRowST( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	// ... source rows are always whole blocks.
+	for ( ; count > 0; count -= 16 )
+	{
+		__m128i index = _mm_setzero_si128();
+		for ( int k = 0; k < PLANES; ++k )
+		{
+			uint16_t word;
+			memcpy( &word, pSrc + k * 2, 2 );
+			index = _mm_or_si128( index, _mm_and_si128( expandBits16( word ), _mm_set1_epi8( 1 << k ) ) );
+		}
+
+		storeIndices( index, count, pDst8 );
+
+		pSrc += PLANES * 2;
+		pDst8 += 16;
+	}
+}
+
+// Unpack a row of 8-pixel planar blocks, two at a time. STEP is the distance between
+// planes, UNIT the distance between blocks.
+template< int PLANES, int STEP, int UNIT >
+static void unpackRowPlanar8( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	for ( ; count > 0; count -= 16 )
+	{
+		// ... the second block is only there if the row has more than 8 pixels left.
+		const bool bSecond = count > 8;
+
+		__m128i index = _mm_setzero_si128();
+		for ( int k = 0; k < PLANES; ++k )
+		{
+			const uint32_t bits = pSrc[ k * STEP ] | ( bSecond ? ( pSrc[ UNIT + k * STEP ] << 8 ) : 0 );
+			index = _mm_or_si128( index, _mm_and_si128( expandBits16( bits ), _mm_set1_epi8( 1 << k ) ) );
+		}
+
+		storeIndices( index, count, pDst8 );
+
+		pSrc += UNIT * 2;
+		pDst8 += 16;
+	}
+}
+
+// Decode an 8x8 pattern, two rows at a time. ROW is the distance between rows,
+// STEP the distance between planes.
+template< int PLANES, int ROW, int STEP >
+static void decodeTilePlanar8( const uint8_t* pSrc, uint8_t* pDst8, int dstPitch )
+{
+	for ( int y = 0; y < 8; y += 2 )
+	{
+		__m128i index = _mm_setzero_si128();
+		for ( int k = 0; k < PLANES; ++k )
+		{
+			const uint32_t bits = pSrc[ y * ROW + k * STEP ] | ( pSrc[ ( y + 1 ) * ROW + k * STEP ] << 8 );
+			index = _mm_or_si128( index, _mm_and_si128( expandBits16( bits ), _mm_set1_epi8( 1 << k ) ) );
+		}
+
+		_mm_storel_epi64( reinterpret_cast< __m128i* >( pDst8 + y * dstPitch ), index );
+		_mm_storel_epi64( reinterpret_cast< __m128i* >( pDst8 + ( y + 1 ) * dstPitch ), _mm_srli_si128( index, 8 ) );
+	}
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// UnpackRow_1bpp_SSE2
+//------------------------------------------------------------------------------
+void UnpackRow_1bpp_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	const __m128i one = _mm_set1_epi8( 1 );
+
+	for ( ; count > 0; count -= 16 )
+	{
+		// ... the second byte is only there if the row has more than 8 pixels left.
+		const uint32_t bits = pSrc[ 0 ] | ( ( count > 8 ) ? ( pSrc[ 1 ] << 8 ) : 0 );
+
+		storeIndices( _mm_and_si128( expandBits16( bits ), one ), count, pDst8 );
+
+		pSrc += 2;
+		pDst8 += 16;
+	}
+}
+
+//------------------------------------------------------------------------------
+// UnpackRow_2bpp_SSE2 / UnpackRow_4bpp_SSE2
+//------------------------------------------------------------------------------
+void UnpackRow_2bpp_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowBytes< 2, 64, unpack16_2bpp >( pSrc, count, pDst8 );
+}
+
+void UnpackRow_4bpp_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowBytes< 4, 32, unpack16_4bpp >( pSrc, count, pDst8 );
+}
+
+//------------------------------------------------------------------------------
+// UnpackRow_Chunky16_SSE2 / UnpackRow_Chunky32_SSE2
+//------------------------------------------------------------------------------
+void UnpackRow_Chunky16_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowBytes< 16, 8, unpack16_Chunky16 >( pSrc, count, pDst8 );
+}
+
+void UnpackRow_Chunky32_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowBytes< 32, 4, unpack16_Chunky32 >( pSrc, count, pDst8 );
+}
+
+//------------------------------------------------------------------------------
+// UnpackRow_ST0_SSE2 / UnpackRow_ST1_SSE2 / UnpackRow_ST2_SSE2
+//------------------------------------------------------------------------------
+void UnpackRow_ST0_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowST< 4 >( pSrc, count, pDst8 );
+}
+
+void UnpackRow_ST1_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowST< 2 >( pSrc, count, pDst8 );
+}
+
+void UnpackRow_ST2_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowST< 1 >( pSrc, count, pDst8 );
+}
+
+//------------------------------------------------------------------------------
+// UnpackRow_SMS_SSE2 / UnpackRow_GB_SSE2 / UnpackRow_NES_SSE2
+//------------------------------------------------------------------------------
+void UnpackRow_SMS_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowPlanar8< 4, 1, 4 >( pSrc, count, pDst8 );
+}
+
+void UnpackRow_GB_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowPlanar8< 2, 1, 2 >( pSrc, count, pDst8 );
+}
+
+void UnpackRow_NES_SSE2( const uint8_t* pSrc, int count, uint8_t* pDst8 )
+{
+	unpackRowPlanar8< 2, 8, 16 >( pSrc, count, pDst8 );
+}
+
+//------------------------------------------------------------------------------
+// DecodeTile8x8_SMS_SSE2 / DecodeTile8x8_GB_SSE2 / DecodeTile8x8_NES_SSE2
+//------------------------------------------------------------------------------
+void DecodeTile8x8_SMS_SSE2( const uint8_t* pSrc, uint8_t* pDst8, int dstPitch )
+{
+	decodeTilePlanar8< 4, 4, 1 >( pSrc, pDst8, dstPitch );
+}
+
+void DecodeTile8x8_GB_SSE2( const uint8_t* pSrc, uint8_t* pDst8, int dstPitch )
+{
+	decodeTilePlanar8< 2, 2, 1 >( pSrc, pDst8, dstPitch );
+}
+
+void DecodeTile8x8_NES_SSE2( const uint8_t* pSrc, uint8_t* pDst8, int dstPitch )
+{
+	decodeTilePlanar8< 2, 1, 8 >( pSrc, pDst8, dstPitch );
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// Mask Helpers
+//------------------------------------------------------------------------------
+
+// SSE2 has no byte shuffle to look up the bitmap, but most sets are a few ranges,
+// and each range is just a subtract and an unsigned compare.
+struct MatchSet16
+{
+	static const int kMaxRanges = 4;
+
+	const IndexSet& set;
+	int rangeCount;
+	__m128i lo[ kMaxRanges ];
+	__m128i span[ kMaxRanges ];
+	__m128i invert;
+
+	MatchSet16( const IndexSet& set, bool bInvert ) :
+
+		set( set ),
+		rangeCount( set.GetRangeCount() ),
+		invert( _mm_set1_epi8( bInvert ? -1 : 0 ) )
+
+	{
+		for ( int r = 0; r < rangeCount && r < kMaxRanges; ++r )
+		{
+			lo[ r ] = _mm_set1_epi8( static_cast< char >( set.GetRangeLo( r ) ) );
+			span[ r ] = _mm_set1_epi8( static_cast< char >( set.GetRangeHi( r ) - set.GetRangeLo( r ) ) );
+		}
+	}
+
+	// Test 16 indices, and gather the result into two MSB-left bytes.
+	uint16_t operator()( __m128i v ) const
+	{
+		__m128i match = _mm_setzero_si128();
+
+		if ( rangeCount <= kMaxRanges )
+		{
+			for ( int r = 0; r < rangeCount; ++r )
+			{
+				// ... v - lo <= hi - lo, unsigned.
+				const __m128i d = _mm_sub_epi8( v, lo[ r ] );
+				match = _mm_or_si128( match, _mm_cmpeq_epi8( _mm_min_epu8( d, span[ r ] ), d ) );
+			}
+		}
+		else
+		{
+			// ... too fragmented, look up each index.
+			uint8_t pixels[ 16 ], bytes[ 16 ];
+			_mm_storeu_si128( reinterpret_cast< __m128i* >( pixels ), v );
+			for ( int i = 0; i < 16; ++i )
+			{
+				bytes[ i ] = set.Contains( pixels[ i ] ) ? UINT8_MAX : 0;
+			}
+			match = _mm_loadu_si128( reinterpret_cast< const __m128i* >( bytes ) );
+		}
+
+		match = _mm_xor_si128( match, invert );
+		return static_cast< uint16_t >( _mm_movemask_epi8( reverseGroupsOf8( match ) ) );
+	}
+};
+
+// Run the test along a row, 16 pixels at a time. STORE writes the bits for
+// 'count' pixels (up to 16). The tail is loaded zero-filled, so missing pixels
+// are tested as index zero.
+template< void ( *STORE )( uint16_t, int, uint8_t* ), int STEP >
+static inline void maskRowBits( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	const MatchSet16 match( set, bInvert );
+
+	for ( ; count >= 16; count -= 16 )
+	{
+		STORE( match( _mm_loadu_si128( reinterpret_cast< const __m128i* >( pSrc8 ) ) ), 16, pDst );
+
+		pSrc8 += 16;
+		pDst += STEP;
+	}
+
+	if ( count > 0 )
+	{
+		uint8_t tail[ 16 ] = {};
+		memcpy( tail, pSrc8, count );
+		STORE( match( _mm_loadu_si128( reinterpret_cast< const __m128i* >( tail ) ) ), count, pDst );
+	}
+}
+
+// 1bpp: the bits are the output.
+static inline void storeMask_1bpp( uint16_t bits, int count, uint8_t* pDst )
+{
+	memcpy( pDst, &bits, ( count > 8 ) ? 2 : 1 );
+}
+
+// Atari ST: every plane of the block is the same word.
+template< int PLANES >
+static inline void storeMask_ST( uint16_t bits, int, uint8_t* pDst )
+{
+	for ( int k = 0; k < PLANES; ++k )
+	{
+		memcpy( pDst + k * 2, &bits, 2 );
+	}
+}
+
+// 8-pixel planar blocks: every plane of each block is the same byte.
+template< int PLANES, int STEP, int UNIT >
+static inline void storeMask_Planar8( uint16_t bits, int count, uint8_t* pDst )
+{
+	for ( int k = 0; k < PLANES; ++k )
+	{
+		pDst[ k * STEP ] = static_cast< uint8_t >( bits );
+	}
+
+	if ( count > 8 )
+	{
+		for ( int k = 0; k < PLANES; ++k )
+		{
+			pDst[ UNIT + k * STEP ] = static_cast< uint8_t >( bits >> 8 );
+		}
+	}
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// MaskRow_1bpp_SSE2
+//------------------------------------------------------------------------------
+void MaskRow_1bpp_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowBits< storeMask_1bpp, 2 >( pSrc8, count, set, bInvert, pDst );
+}
+
+//------------------------------------------------------------------------------
+// MaskRow_ST0_SSE2 / MaskRow_ST1_SSE2 / MaskRow_ST2_SSE2
+//------------------------------------------------------------------------------
+void MaskRow_ST0_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowBits< storeMask_ST< 4 >, 8 >( pSrc8, count, set, bInvert, pDst );
+}
+
+void MaskRow_ST1_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowBits< storeMask_ST< 2 >, 4 >( pSrc8, count, set, bInvert, pDst );
+}
+
+void MaskRow_ST2_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowBits< storeMask_ST< 1 >, 2 >( pSrc8, count, set, bInvert, pDst );
+}
+
+//------------------------------------------------------------------------------
+// MaskRow_SMS_SSE2 / MaskRow_GB_SSE2 / MaskRow_NES_SSE2
+//------------------------------------------------------------------------------
+void MaskRow_SMS_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowBits< storeMask_Planar8< 4, 1, 4 >, 8 >( pSrc8, count, set, bInvert, pDst );
+}
+
+void MaskRow_GB_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowBits< storeMask_Planar8< 2, 1, 2 >, 4 >( pSrc8, count, set, bInvert, pDst );
+}
+
+void MaskRow_NES_SSE2( const uint8_t* pSrc8, int count, const IndexSet& set, bool bInvert, uint8_t* pDst )
+{
+	maskRowBits< storeMask_Planar8< 2, 8, 16 >, 32 >( pSrc8, count, set, bInvert, pDst );
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// Widen Helpers
+//------------------------------------------------------------------------------
+
+// Store 16 pixels, each repeated SCALE times. Unpacking a register with itself
+// doubles every byte, so each level of recursion doubles the scale.
+template< int SCALE >
+static inline void storeWidened( __m128i v, uint8_t* pDst )
+{
+	storeWidened< SCALE / 2 >( _mm_unpacklo_epi8( v, v ), pDst );
+	storeWidened< SCALE / 2 >( _mm_unpackhi_epi8( v, v ), pDst + 8 * SCALE );
+}
+
+template<>
+inline void storeWidened< 1 >( __m128i v, uint8_t* pDst )
+{
+	_mm_storeu_si128( reinterpret_cast< __m128i* >( pDst ), v );
+}
+
+// Widen a row from right to left. Block x is written at x * SCALE, which is never
+// below x, so no block is overwritten before it's loaded.
+template< int SCALE >
+static inline int widenBlocks( uint8_t* pRow, int count )
+{
+	while ( count >= 16 )
+	{
+		count -= 16;
+		storeWidened< SCALE >( _mm_loadu_si128( reinterpret_cast< const __m128i* >( pRow + count ) ), pRow + count * SCALE );
+	}
+
+	return count;
+}
+
+//------------------------------------------------------------------------------
+// WidenRow_SSE2
+//------------------------------------------------------------------------------
+void WidenRow_SSE2( uint8_t* pRow, int count, int scale )
+{
+	switch ( scale )
+	{
+	case 2: count = widenBlocks< 2 >( pRow, count ); break;
+	case 4: count = widenBlocks< 4 >( pRow, count ); break;
+	case 8: count = widenBlocks< 8 >( pRow, count ); break;
+	}
+
+	// The pixels left at the start, or the whole row for other scales.
+	for ( int x = count - 1; x >= 0; --x )
+	{
+		memset( pRow + x * scale, pRow[ x ], scale );
+	}
+}
+
+//==============================================================================
+
+#endif // ROW_KERNELS_X64
@@ -34,6 +34,7 @@ SOFTWARE.
 #include "FileReader.h"
 #include "Image.h"
 #include "ImageInfo.h"
+#include "RowKernels.h"
 
 //==============================================================================
 
@@ -58,6 +59,168 @@ static void read_data_fn( png_structp png_ptr, png_bytep p_data, png_size_t size
 //	printf( "size = %d, file_reader.pos = %d\n", size, file_reader.GetReadCursor() );
 }
 
+//
+// unpack_indices
+//
+// Unpack a row of 1, 2, 4 or 8-bit palette indices into CHUNKY_8. Returns the
+// highest index in the row.
+//
+static uint32_t unpack_indices( const uint8_t* p, uint32_t width, png_byte bit_depth, uint8_t* p_dst )
+{
+	uint32_t uMaxIndex = 0;
+
+	switch ( bit_depth )
+	{
+
+	case 1:
+		{
+			uint8_t feed = 0;
+			// simple: 1 src byte = 8 indices (LSB[idx7:idx6:idx5:idx4:idx3:idx2:idx1:idx0]MSB)
+			for ( uint32_t x = 0; x < width; ++x )
+			{
+				uint32_t index;
+
+				const uint8_t sub = ( x & 7 );
+				if ( sub == 0 )
+				{
+					feed = *p++; // feed in up to 8 new indices.
+					index = ( feed >> 7 ); // first index
+				}
+				else
+				{
+					index = ( feed >> ( 7 - sub ) ) & 1;
+				}
+
+				// Store pixel, and grow the max index.
+				p_dst[ x ] = static_cast< uint8_t >( index );
+				uMaxIndex = std::max( uMaxIndex, index );
+			}
+		}
+		break;
+
+	case 2:
+		{
+			uint8_t feed = 0;
+			// simple: 1 src byte = 4 indices (LSB[idx3:idx2:idx1:idx0]MSB)
+			for ( uint32_t x = 0; x < width; ++x )
+			{
+				uint32_t index;
+
+				const uint8_t sub = ( x & 3 );
+				if ( sub == 0 )
+				{
+					feed = *p++; // feed in up to 4 new indices.
+					index = ( feed >> 6 ); // first index
+				}
+				else
+				{
+					index = ( feed >> ( 6 - ( sub << 1 ) ) ) & 3;
+				}
+
+				// Store pixel, and grow the max index.
+				p_dst[ x ] = static_cast< uint8_t >( index );
+				uMaxIndex = std::max( uMaxIndex, index );
+			}
+		}
+		break;
+
+	case 4:
+		{
+			uint8_t feed = 0;
+			// simple: 1 src byte = 2 indices (LSB[idx1:idx0]MSB)
+			for ( uint32_t x = 0; x < width; ++x )
+			{
+				uint32_t index;
+
+				if ( x & 1 )
+				{
+					// odd
+					index = ( feed & 0xF ); // second index.
+				}
+				else
+				{
+					// even
+					feed = *p++; // feed in up to 2 new indices.
+					index = ( feed >> 4 ); // first index
+				}
+
+				// Store pixel, and grow the max index.
+				p_dst[ x ] = static_cast< uint8_t >( index );
+				uMaxIndex = std::max( uMaxIndex, index );
+			}
+		}
+		break;
+
+	case 8:
+		{
+			// simple: 1 src byte = 1 index; no need to check for index overflow.
+			for ( uint32_t x = 0; x < width; ++x )
+			{
+				uint32_t index = *p++;
+
+				// Store pixel, and grow the max index.
+				p_dst[ x ] = static_cast< uint8_t >( index );
+				uMaxIndex = std::max( uMaxIndex, index );
+			}
+		}
+		break;
+
+	}; // switch ( bit_depth )
+
+	return uMaxIndex;
+}
+
+//
+// read_palette
+//
+// Copy the palette of an indexed image to p_info, as ARGB.
+//
+static void read_palette( png_structp png_ptr, png_infop info_ptr, ImageInfo* p_info )
+{
+	// ... png_get_tRNS leaves these alone if there's no tRNS chunk.
+	png_bytep trans_alpha = nullptr;
+	int num_trans = 0;
+	png_color_16p trans_color = nullptr;
+	png_get_tRNS( png_ptr, info_ptr, &trans_alpha, &num_trans, &trans_color );
+	
+	png_colorp palette;
+	int palette_size;
+	png_get_PLTE( png_ptr, info_ptr, &palette, &palette_size );
+
+	for ( int i = 0; i < palette_size; ++i )
+	{
+		const png_color& e = palette[ i ];
+
+		uint32_t rgb;
+		rgb = ( e.red << 16 ) | ( e.green << 8 ) | ( e.blue << 0 );
+
+		if ( i < num_trans )
+		{
+			rgb |= ( trans_alpha[ i ] ) << 24;
+		}
+		else
+		{
+			rgb |= ( 0xFF << 24 );
+		}
+
+		p_info->palette.push_back( rgb );
+	}
+}
+
+//
+// kFeedBytes
+//
+// How much of the file is passed to libpng at a time when reading rows. libpng
+// inflates everything it's given before it returns, and every row has to be
+// held until it's read, so the feed is cut down until even the most compressed
+// data (about 1032:1 for deflate) can't inflate to more than kQueueRows rows.
+// The header is fed kMinFeedBytes at a time, as the row size isn't known yet.
+//
+static const uint32_t kFeedBytes = 8192;
+static const uint32_t kMinFeedBytes = 256;
+static const uint32_t kQueueRows = 32;
+static const uint32_t kMaxInflateRatio = 1032;
+
 //
 // error_fn
 //
@@ -84,7 +247,21 @@ static void warn_fn( png_structp png_ptr, png_const_charp error_message )
 //------------------------------------------------------------------------------
 // cPNG::cPNG
 //------------------------------------------------------------------------------
-cPNG::cPNG()
+cPNG::cPNG() :
+
+	m_png_ptr( nullptr ),
+	m_info_ptr( nullptr ),
+	m_p_reader( nullptr ),
+	m_width( 0 ),
+	m_bit_depth( 0 ),
+	m_p_rows( nullptr ),
+	m_rows_capacity( 0 ),
+	m_rowbytes( 0 ),
+	m_feed_bytes( kMinFeedBytes ),
+	m_rows_queued( 0 ),
+	m_rows_next( 0 ),
+	m_b_have_info( false )
+
 {
 	//
 }
@@ -94,7 +271,7 @@ cPNG::cPNG()
 //------------------------------------------------------------------------------
 cPNG::~cPNG()
 {
-	//
+	EndRows();
 }
 
 //==============================================================================
@@ -135,6 +312,8 @@ bool cPNG::LoadTo( FileReader& reader,
 				   Image& image,
 				   ImageInfo* p_info,
 				   const uint32_t want, 
+				   const uint32_t scale_x,
+				   const uint32_t scale_y,
 				   std::string& error )
 {
 	// 8 is the maximum size that can be checked
@@ -178,7 +357,7 @@ bool cPNG::LoadTo( FileReader& reader,
 		else
 		{
 			// GO!
-			if ( LoadTo_Internal( png_ptr, info_ptr, reader, p_info, want, image, &compatible_format, error ) )
+			if ( LoadTo_Internal( png_ptr, info_ptr, reader, p_info, want, scale_x, scale_y, image, &compatible_format, error ) )
 			{
 				// .. made it!
 				completed = true;
@@ -212,6 +391,8 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							FileReader& reader,
 							ImageInfo* p_info,
 							const uint32_t want,
+							const uint32_t scale_x,
+							const uint32_t scale_y,
 							Image &image,
 							bool* p_compatible_format,
 							std::string& error )
@@ -364,6 +545,14 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 
 	}; // switch ( want )
 
+	// Scaling is done on 8-bit pixels, as each row is decoded.
+	if ( ( scale_x > 1 || scale_y > 1 ) && image_format != PixelFormat::CHUNKY_8 && want_idx_bits == 0 )
+	{
+		error = "Scaling is only supported for 8-bit and indexed images.";
+		*p_compatible_format = false;
+		return false;
+	}
+
 	// Palette?
 	if ( colour_type == PNG_COLOR_TYPE_PALETTE )
 	{
@@ -531,8 +720,13 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 	{
 //		assert( src_pitch > 0, "Invalid source pitch for supposedly compatible format" );
 
-		// Allocate the image
-		image.Create( image_format, padded_image_width, padded_image_height );
+		// Allocate the image. Rows are padded so that conversion kernels can read
+		// a whole vector past the last pixel.
+		ImageLayout layout;
+		layout.rowPadding = 64;
+		layout.bHugePages = true;
+
+		image.Create( image_format, padded_image_width * scale_x, padded_image_height * scale_y, layout );
 
 		// RGB expansion helper. Can't use this for palette images :(
 		if ( png_bit_depth < 8 && colour_type != PNG_COLOR_TYPE_PALETTE )
@@ -556,10 +750,21 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 		// How many bytes in a row?
 		const png_size_t row_bytes = png_get_rowbytes( png_ptr, info_ptr );
 
+		// Scaling kernel
+		const fnWidenRow widenRow = GetWidenRowKernel();
+
 		// Create row buffer
 		png_bytep p_src_row;
 		p_src_row = reinterpret_cast< png_bytep >( malloc( row_bytes ) );
 
+		// Indexed rows are decoded as CHUNKY_8. That's straight into the image, or into
+		// this buffer to be packed with the image's row kernel. Padding stays zero.
+		uint8_t* p_idx_buffer = nullptr;
+		if ( channels == UINT32_MAX && image_format != PixelFormat::CHUNKY_8 )
+		{
+			p_idx_buffer = reinterpret_cast< uint8_t* >( calloc( image.GetStride(), 1 ) );
+		}
+
 		uint32_t uMaxIndex = 0; // <-- computed below.
 
 		// Set colour mode info.
@@ -570,36 +775,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 
 			if ( p_info->bIndexed )
 			{
-				//
-				// --Get palette
-
-				png_bytep trans_alpha;
-				int num_trans;
-				png_color_16p trans_color;
-				png_get_tRNS( png_ptr, info_ptr, &trans_alpha, &num_trans, &trans_color );
-				
-				png_colorp palette;
-				int palette_size;
-				png_get_PLTE( png_ptr, info_ptr, &palette, &palette_size );
-
-				for ( int i = 0; i < palette_size; ++i )
-				{
-					const png_color& e = palette[ i ];
-
-					uint32_t rgb;
-					rgb = ( e.red << 16 ) | ( e.green << 8 ) | ( e.blue << 0 );
-
-					if ( i < num_trans )
-					{
-						rgb |= ( trans_alpha[ i ] ) << 24;
-					}
-					else
-					{
-						rgb |= ( 0xFF << 24 );
-					}
-
-					p_info->palette.push_back( rgb );
-				}
+				read_palette( png_ptr, info_ptr, p_info );
 			}
 		}
 
@@ -614,6 +790,10 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 				// Read a row (read it multiple times if it's interlaced)
 				png_read_row( png_ptr, nullptr, p_src_row );
 
+				// Scaled images are decoded into the first of each group of rows.
+				const uint32_t dst_y = y * scale_y;
+				uint8_t* p_idx_row = p_idx_buffer ? p_idx_buffer : image.GetRowPtr( dst_y );
+
 				uint8_t* p = ( uint8_t* )p_src_row;
 
 				// Swizzle & Expand!
@@ -630,82 +810,9 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 						{
 
 						case 1:
-							{
-								uint8_t feed = 0;
-								// simple: 1 src byte = 8 indices (LSB[idx7:idx6:idx5:idx4:idx3:idx2:idx1:idx0]MSB)
-								for ( uint32_t x = 0; x < real_image_width; ++x )
-								{
-									uint32_t index;
-
-									const uint8_t sub = ( x & 7 );
-									if ( sub == 0 )
-									{
-										feed = *p++; // feed in up to 8 new indices.
-										index = ( feed >> 7 ); // first index
-									}
-									else
-									{
-										index = ( feed >> ( 7 - sub ) ) & 1;
-									}
-
-									// Store pixel, and grow the max index.
-									image.Plot( x, y, index );
-									uMaxIndex = std::max( uMaxIndex, index );
-								}
-							}
-							break;
-
 						case 2:
-							{
-								uint8_t feed = 0;
-								// simple: 1 src byte = 4 indices (LSB[idx3:idx2:idx1:idx0]MSB)
-								for ( uint32_t x = 0; x < real_image_width; ++x )
-								{
-									uint32_t index;
-
-									const uint8_t sub = ( x & 3 );
-									if ( sub == 0 )
-									{
-										feed = *p++; // feed in up to 4 new indices.
-										index = ( feed >> 6 ); // first index
-									}
-									else
-									{
-										index = ( feed >> ( 6 - ( sub << 1 ) ) ) & 3;
-									}
-
-									// Store pixel, and grow the max index.
-									image.Plot( x, y, index );
-									uMaxIndex = std::max( uMaxIndex, index );
-								}
-							}
-							break;
-
 						case 4:
-							{
-								uint8_t feed = 0;
-								// simple: 1 src byte = 2 indices (LSB[idx1:idx0]MSB)
-								for ( uint32_t x = 0; x < real_image_width; ++x )
-								{
-									uint32_t index;
-
-									if ( x & 1 )
-									{
-										// odd
-										index = ( feed & 0xF ); // second index.
-									}
-									else
-									{
-										// even
-										feed = *p++; // feed in up to 2 new indices.
-										index = ( feed >> 4 ); // first index
-									}
-
-									// Store pixel, and grow the max index.
-									image.Plot( x, y, index );
-									uMaxIndex = std::max( uMaxIndex, index );
-								}
-							}
+							uMaxIndex = std::max( uMaxIndex, unpack_indices( p, real_image_width, png_bit_depth, p_idx_row ) );
 							break;
 
 						case 8:
@@ -713,14 +820,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							if ( want_idx_bits >= 8 )
 							{
 								// simple: 1 src byte = 1 index; no need to check for index overflow.
-								for ( uint32_t x = 0; x < real_image_width; ++x )
-								{
-									uint32_t index = *p++;
-
-									// Store pixel, and grow the max index.
-									image.Plot( x, y, index );
-									uMaxIndex = std::max( uMaxIndex, index );
-								}
+								uMaxIndex = std::max( uMaxIndex, unpack_indices( p, real_image_width, png_bit_depth, p_idx_row ) );
 							}
 							else
 							{
@@ -742,7 +842,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 										goto abort_compatible_format;
 									}
 
-									image.Plot( x, y, feed );
+									p_idx_row[ x ] = static_cast< uint8_t >( feed );
 									uMaxIndex = std::max( uMaxIndex, static_cast< uint32_t >( feed ) );
 								}
 							}
@@ -776,7 +876,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 					case Loader::WANT_LA4: // alpha only, so use lum=1
 						{
 							// Get target row.
-							uint8_t* p_dst_row = ( uint8_t* )( image.GetRowPtr( y ) );
+							uint8_t* p_dst_row = ( uint8_t* )( image.GetRowPtr( dst_y ) );
 
 							for ( uint32_t x = 0; x < real_image_width; x += 2 )
 							{
@@ -798,7 +898,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							// ... clear remaining columns
 							for ( uint32_t x = real_image_width; x < padded_image_width; ++x )
 							{
-								image.Plot( x, y, 0 ); // 
+								image.Plot( x, dst_y, 0 ); // 
 							}
 						}
 						break;
@@ -808,13 +908,13 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							for ( uint32_t x = 0; x < real_image_width; ++x )
 							{
 								uint8_t a = *p++; // feed in a new alpha value.
-								image.Plot( x, y, 0xF0 | ( a >> 4 ) ); // 1/A
+								image.Plot( x, dst_y, 0xF0 | ( a >> 4 ) ); // 1/A
 							}
 
 							// ... clear remaining columns
 							for ( uint32_t x = real_image_width; x < padded_image_width; ++x )
 							{
-								image.Plot( x, y, 0 ); // 
+								image.Plot( x, dst_y, 0 ); // 
 							}
 						}
 						break;
@@ -824,13 +924,13 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							for ( uint32_t x = 0; x < real_image_width; ++x )
 							{
 								uint8_t a = *p++; // feed in a new alpha value.
-								image.Plot( x, y, a >> 4 ); // 
+								image.Plot( x, dst_y, a >> 4 ); // 
 							}
 
 							// ... clear remaining columns
 							for ( uint32_t x = real_image_width; x < padded_image_width; ++x )
 							{
-								image.Plot( x, y, 0 ); // 
+								image.Plot( x, dst_y, 0 ); // 
 							}
 						}
 						break;
@@ -838,7 +938,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 					case Loader::WANT_A8:
 						{
 							// Get target row.
-							uint8_t* p_dst_row = ( uint8_t* )( image.GetRowPtr( y ) );
+							uint8_t* p_dst_row = ( uint8_t* )( image.GetRowPtr( dst_y ) );
 
 							// ... copy data row.
 							memcpy( p_dst_row, p, real_image_width );
@@ -855,7 +955,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 					case Loader::WANT_A16:
 						{
 							// Get target row.
-							uint16_t* p_dst_row = ( uint16_t* )( image.GetRowPtr( y ) );
+							uint16_t* p_dst_row = ( uint16_t* )( image.GetRowPtr( dst_y ) );
 
 							if ( png_bit_depth == 8 )
 							{
@@ -889,7 +989,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							uint32_t dst;
 
 							// Get the target row
-							uint32_t* p_dst_row = ( uint32_t* )( image.GetRowPtr( y ) );
+							uint32_t* p_dst_row = ( uint32_t* )( image.GetRowPtr( dst_y ) );
 
 							if ( want_colour == Loader::WANT_LA16 )
 							{
@@ -950,7 +1050,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 
 						{
 							// Get the target row
-							uint8_t* p_dst_row = ( uint8_t* )( image.GetRowPtr( y ) );
+							uint8_t* p_dst_row = ( uint8_t* )( image.GetRowPtr( dst_y ) );
 
 							uint32_t x = 0;
 
@@ -986,7 +1086,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 
 						{
 							// Get the target row
-							uint8_t* p_dst_row = ( uint8_t* )( image.GetRowPtr( y ) );
+							uint8_t* p_dst_row = ( uint8_t* )( image.GetRowPtr( dst_y ) );
 
 							uint32_t x = 0;
 
@@ -1018,7 +1118,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 
 						{
 							// Get the target row
-							uint8_t* p_dst_row = ( uint8_t* )( image.GetRowPtr( y ) );
+							uint8_t* p_dst_row = ( uint8_t* )( image.GetRowPtr( dst_y ) );
 
 							uint32_t x = 0;
 
@@ -1050,7 +1150,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							uint32_t dst;
 
 							// Get the target row
-							uint32_t* p_dst_row = ( uint32_t* )( image.GetRowPtr( y ) );
+							uint32_t* p_dst_row = ( uint32_t* )( image.GetRowPtr( dst_y ) );
 
 							uint32_t x = 0;
 
@@ -1093,7 +1193,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							uint16_t out;
 
 							// Get the target row
-							uint16_t* p_dst_row = ( uint16_t* )( image.GetRowPtr( y ) );
+							uint16_t* p_dst_row = ( uint16_t* )( image.GetRowPtr( dst_y ) );
 
 							uint32_t x = 0;
 
@@ -1127,7 +1227,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							uint32_t dst;
 
 							// Get the target row
-							uint32_t* p_dst_row = ( uint32_t* )( image.GetRowPtr( y ) );
+							uint32_t* p_dst_row = ( uint32_t* )( image.GetRowPtr( dst_y ) );
 
 							uint32_t x = 0;
 
@@ -1172,7 +1272,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							uint16_t out;
 
 							// Get the target row
-							uint16_t* p_dst_row = ( uint16_t* )( image.GetRowPtr( y ) );
+							uint16_t* p_dst_row = ( uint16_t* )( image.GetRowPtr( dst_y ) );
 
 							uint32_t x = 0;
 
@@ -1210,7 +1310,7 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 							uint32_t dst;
 
 							// Get the target row
-							uint32_t* p_dst_row = ( uint32_t* )( image.GetRowPtr( y ) );
+							uint32_t* p_dst_row = ( uint32_t* )( image.GetRowPtr( dst_y ) );
 
 							uint32_t x = 0;
 
@@ -1249,6 +1349,20 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 
 				}; // switch ( channels )
 
+				// Scale up the row in place, pack it if need be, then repeat it.
+				if ( scale_x > 1 )
+				{
+					widenRow( p_idx_buffer ? p_idx_buffer : image.GetRowPtr( dst_y ), static_cast< int >( padded_image_width ), static_cast< int >( scale_x ) );
+				}
+				if ( p_idx_buffer )
+				{
+					image.PackRow( dst_y, p_idx_buffer );
+				}
+				for ( uint32_t i = 1; i < scale_y; ++i )
+				{
+					memcpy( image.GetRowPtr( dst_y + i ), image.GetRowPtr( dst_y ), image.GetPitch() );
+				}
+
 			}; // for each row
 
 //----------------------------------
@@ -1257,13 +1371,14 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 
 	abort_compatible_format:
 
-		// Free temp row buffer
+		// Free temp row buffers
 		free( p_src_row );
+		free( p_idx_buffer );
 
 		// Pad remaining rows (only if we're still a valid image).
 		if ( image.GetRowPtr( 0 ) )
 		{
-			for ( uint32_t y = real_image_height; y < padded_image_height; ++y )
+			for ( uint32_t y = real_image_height * scale_y; y < padded_image_height * scale_y; ++y )
 			{
 				// Clear the target row - pixel size agnostic
 				uint8_t* p_dst_row = image.GetRowPtr( y );
@@ -1285,3 +1400,259 @@ bool cPNG::LoadTo_Internal( void* _png_ptr,
 }
 
 //==============================================================================
+
+//------------------------------------------------------------------------------
+// cPNG::BeginRows
+//------------------------------------------------------------------------------
+bool cPNG::BeginRows( FileReader& reader, ImageInfo* p_info, bool* p_interlaced, std::string& error )
+{
+	*p_interlaced = false;
+
+	// Start afresh.
+	EndRows();
+
+	// 8 is the maximum size that can be checked
+	uint8_t header[ 8 ];
+	if ( reader.Read( header, 8 ) == false )
+	{
+		return false; // <=== EARLY OUT
+	}
+
+	// Not a .PNG file?
+	if ( png_sig_cmp( header, 0, 8 ) )
+	{
+		error = "Attempted to decompress a non-PNG file.";
+		return false; // <=== EARLY OUT
+	}
+
+	// Initialise the reader.
+	png_structp png_ptr = png_create_read_struct( PNG_LIBPNG_VER_STRING, this, error_fn, warn_fn );
+	if ( png_ptr == nullptr )
+	{
+		error = "png_create_read_struct failed.";
+		return false; // <=== EARLY OUT
+	}
+
+	m_png_ptr = png_ptr;
+
+	// Initialise the information structure.
+	png_infop info_ptr = png_create_info_struct( png_ptr );
+	if ( info_ptr == nullptr )
+	{
+		error = "png_create_info_struct failed.";
+		EndRows();
+		return false; // <=== EARLY OUT
+	}
+
+	m_info_ptr = info_ptr;
+
+	// If libpng fails, we land here.
+	jmp_buf* p_jmp_buf = png_set_longjmp_fn( png_ptr, longjmp, sizeof( jmp_buf ) );
+	if ( setjmp( *p_jmp_buf ) == -1 )
+	{
+		EndRows();
+		return false;
+	}
+
+	// Chunks are fed in as they're read, and libpng calls back.
+	m_p_reader = &reader;
+	png_set_progressive_read_fn( png_ptr, this, info_fn, row_fn, nullptr );
+
+	// Hand back the earlier pre-read. The progressive reader can't skip it.
+	png_process_data( png_ptr, info_ptr, header, 8 );
+
+	// Feed it up to the first IDAT, which is where the header ends.
+	while ( m_b_have_info == false )
+	{
+		if ( FeedChunk() == false )
+		{
+			error = "The file ended before the image data.";
+			EndRows();
+			return false;
+		}
+	}
+
+	const png_byte png_bit_depth = png_get_bit_depth( png_ptr, info_ptr );
+
+	// Palette images only, as WANT_IDX8.
+	if ( png_get_color_type( png_ptr, info_ptr ) != PNG_COLOR_TYPE_PALETTE || png_bit_depth > 8 )
+	{
+		error = "Not an indexed image.";
+		EndRows();
+		return false;
+	}
+
+	// Interlaced rows only make sense once every pass is done.
+	if ( png_get_interlace_type( png_ptr, info_ptr ) != PNG_INTERLACE_NONE )
+	{
+		*p_interlaced = true;
+		EndRows();
+		return false;
+	}
+
+	m_width = png_get_image_width( png_ptr, info_ptr );
+	m_bit_depth = png_bit_depth;
+
+	// Store info
+	if ( p_info )
+	{
+		p_info->format = ImageSourceFormat::PNG;
+		p_info->width = m_width;
+		p_info->height = png_get_image_height( png_ptr, info_ptr );
+		p_info->bIndexed = true;
+		p_info->uMaxIndex = 0;
+
+		read_palette( png_ptr, info_ptr, p_info );
+	}
+
+	// Ready the decoder for rows.
+	png_start_read_image( png_ptr );
+	m_rowbytes = static_cast< uint32_t >( png_get_rowbytes( png_ptr, info_ptr ) );
+
+	// Feed enough for about kQueueRows rows at worst.
+	const size_t feed_bytes = static_cast< size_t >( kQueueRows ) * m_rowbytes / kMaxInflateRatio;
+	m_feed_bytes = static_cast< uint32_t >( std::min< size_t >( std::max< size_t >( feed_bytes, kMinFeedBytes ), kFeedBytes ) );
+
+	// Carry on with what was left of the chunk at the pause.
+	png_process_data( png_ptr, info_ptr, header, 0 );
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// cPNG::ReadRow
+//------------------------------------------------------------------------------
+bool cPNG::ReadRow( uint8_t* p_dst8, uint32_t* p_max_index )
+{
+	png_structp png_ptr = ( png_structp )m_png_ptr;
+	if ( png_ptr == nullptr || m_rowbytes == 0 )
+	{
+		return false;
+	}
+
+	// If libpng fails, we land here.
+	jmp_buf* p_jmp_buf = png_set_longjmp_fn( png_ptr, longjmp, sizeof( jmp_buf ) );
+	if ( setjmp( *p_jmp_buf ) == -1 )
+	{
+		EndRows();
+		return false;
+	}
+
+	// Feed the file in until a row comes out.
+	while ( m_rows_next == m_rows_queued )
+	{
+		m_rows_queued = 0;
+		m_rows_next = 0;
+
+		if ( FeedChunk() == false )
+		{
+			EndRows();
+			return false;
+		}
+	}
+
+	const uint8_t* p_src_row = m_p_rows + static_cast< size_t >( m_rows_next++ ) * m_rowbytes;
+
+	const uint32_t uMaxIndex = unpack_indices( p_src_row, m_width, m_bit_depth, p_dst8 );
+	*p_max_index = std::max( *p_max_index, uMaxIndex );
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// cPNG::EndRows
+//------------------------------------------------------------------------------
+void cPNG::EndRows()
+{
+	if ( m_png_ptr )
+	{
+		png_structp png_ptr = ( png_structp )m_png_ptr;
+		png_infop info_ptr = ( png_infop )m_info_ptr;
+
+		png_destroy_read_struct( &png_ptr, &info_ptr, nullptr );
+	}
+
+	free( m_p_rows );
+
+	m_png_ptr = nullptr;
+	m_info_ptr = nullptr;
+	m_p_reader = nullptr;
+	m_width = 0;
+	m_bit_depth = 0;
+	m_p_rows = nullptr;
+	m_rows_capacity = 0;
+	m_rowbytes = 0;
+	m_feed_bytes = kMinFeedBytes;
+	m_rows_queued = 0;
+	m_rows_next = 0;
+	m_b_have_info = false;
+}
+
+//------------------------------------------------------------------------------
+// cPNG::FeedChunk
+//------------------------------------------------------------------------------
+bool cPNG::FeedChunk()
+{
+	png_structp png_ptr = ( png_structp )m_png_ptr;
+	png_infop info_ptr = ( png_infop )m_info_ptr;
+
+	// ... a mapped file is passed straight through, without a copy.
+	const uint8_t* p_data;
+	const uint32_t count = m_p_reader->ReadChunk( &p_data, m_feed_bytes );
+	if ( count == 0 )
+	{
+		return false;
+	}
+
+	png_process_data( png_ptr, info_ptr, const_cast< png_bytep >( p_data ), count );
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// cPNG::info_fn
+//------------------------------------------------------------------------------
+void cPNG::info_fn( png_structp png_ptr, png_infop info_ptr )
+{
+	( void )info_ptr;
+
+	cPNG* p_this = reinterpret_cast< cPNG* >( png_get_progressive_ptr( png_ptr ) );
+	p_this->m_b_have_info = true;
+
+	// Stop here, so BeginRows can check the format before any rows. libpng
+	// keeps what's left of the chunk for the next feed.
+	png_process_data_pause( png_ptr, 1 );
+}
+
+//------------------------------------------------------------------------------
+// cPNG::row_fn
+//------------------------------------------------------------------------------
+void cPNG::row_fn( png_structp png_ptr, png_bytep p_row, png_uint_32 row_num, int pass )
+{
+	// ... rows arrive in order, and never interlaced.
+	( void )row_num;
+	( void )pass;
+
+	cPNG* p_this = reinterpret_cast< cPNG* >( png_get_progressive_ptr( png_ptr ) );
+
+	// Grow the queue to fit, keeping any rows it already has.
+	const size_t needed = static_cast< size_t >( p_this->m_rows_queued + 1 ) * p_this->m_rowbytes;
+	if ( needed > p_this->m_rows_capacity )
+	{
+		const size_t capacity = std::max( needed, p_this->m_rows_capacity * 2 );
+
+		uint8_t* p_rows = reinterpret_cast< uint8_t* >( realloc( p_this->m_p_rows, capacity ) );
+		if ( p_rows == nullptr )
+		{
+			png_error( png_ptr, "Out of memory for rows." );
+		}
+
+		p_this->m_p_rows = p_rows;
+		p_this->m_rows_capacity = capacity;
+	}
+
+	memcpy( p_this->m_p_rows + needed - p_this->m_rowbytes, p_row, p_this->m_rowbytes );
+	++p_this->m_rows_queued;
+}
+
+//==============================================================================
@@ -24,12 +24,17 @@ SOFTWARE.
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 struct ImageInfo;
 class Image;
 class FileReader;
 
+// libpng
+struct png_struct_def;
+struct png_info_def;
+
 //==============================================================================
 
 //-----------------------------------------------------------------------------
@@ -64,11 +69,41 @@ public:
 	//
 	// LoadTo
 	//
-	// Decompresses the given PNG file into the given image object.
+	// Decompresses the given PNG file into the given image object. Each row is
+	// scaled up by scale_x and scale_y as it's decoded (8-bit and indexed images
+	// only).
 	//
 	// \return True if the image was decompressed successfully.
 	//
-	bool LoadTo( FileReader& reader, Image& image, ImageInfo* p_info, const uint32_t want, std::string& error );
+	bool LoadTo( FileReader& reader, Image& image, ImageInfo* p_info, const uint32_t want, const uint32_t scale_x, const uint32_t scale_y, std::string& error );
+
+	//
+	// BeginRows
+	//
+	// Start decompressing an indexed PNG a row at a time, as for WANT_IDX8. The
+	// file is fed to libpng's progressive reader a chunk at a time, as rows are
+	// wanted, so it never has to be read in ahead. The reader must stay alive
+	// until EndRows. Interlaced images can't be read this way: the call fails
+	// and sets *p_interlaced, so the caller can use LoadTo.
+	//
+	// \return True if rows can now be read with ReadRow.
+	//
+	bool BeginRows( FileReader& reader, ImageInfo* p_info, bool* p_interlaced, std::string& error );
+
+	//
+	// ReadRow
+	//
+	// Decompress the next row into width CHUNKY_8 indices, and grow *p_max_index
+	// to the highest index seen.
+	//
+	bool ReadRow( uint8_t* p_dst8, uint32_t* p_max_index );
+
+	//
+	// EndRows
+	//
+	// Stop reading rows and free the decoder. Safe to call at any time.
+	//
+	void EndRows();
 
 
 	//--------------------------------------------------------------------------
@@ -85,10 +120,45 @@ public:
 
 private:
 
+	//--------------------------------------------------------------------------
+	// Implementation Data
+	//--------------------------------------------------------------------------
+
+	// Row reading state. See BeginRows.
+	void* m_png_ptr;
+	void* m_info_ptr;
+	FileReader* m_p_reader;
+	uint32_t m_width;
+	uint8_t m_bit_depth;
+
+	// Rows inflated from the last chunk fed to libpng, waiting for ReadRow.
+	uint8_t* m_p_rows;
+	size_t m_rows_capacity;
+	uint32_t m_rowbytes;
+	uint32_t m_feed_bytes; // Small until the header is read. See kFeedBytes.
+	uint32_t m_rows_queued;
+	uint32_t m_rows_next;
+	bool m_b_have_info;
+
+
 	//--------------------------------------------------------------------------
 	// Helpers
 	//--------------------------------------------------------------------------
 
+	//
+	// FeedChunk
+	//
+	// Pass the next chunk of the file to libpng, which calls back as it finds
+	// the header and each row. Returns false at the end of the file.
+	//
+	bool FeedChunk();
+
+	//
+	// Progressive callbacks. The progressive pointer is the cPNG.
+	//
+	static void info_fn( png_struct_def* png_ptr, png_info_def* info_ptr );
+	static void row_fn( png_struct_def* png_ptr, uint8_t* p_row, uint32_t row_num, int pass );
+
 	//
 	// LoadTo_Internal
 	//
@@ -99,6 +169,8 @@ private:
 						  FileReader& reader,
 						  ImageInfo* p_info,
 						  const uint32_t want,
+						  const uint32_t scale_x,
+						  const uint32_t scale_y,
 						  Image &image,
 						  bool* p_compatible_format, 
 						  std::string& error );
@@ -24,24 +24,33 @@ SOFTWARE.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "utils.h"
 #include "Image.h"
+#include "PixelFormatTraits.h"
 #include "ImageInfo.h"
+#include "FileReader.h"
+#include "FileWriter.h"
+#include "Loader.h"
 
 //==============================================================================
 
 struct OptionsExport
 {
-	int iShift = 0;
+	std::vector< int > shifts = { 0 }; // one output per shift
+	bool bAllShifts = false;
 	const char* pInputName = nullptr;
 	const char* pOutputName = nullptr;
 	PixelFormat dataOutFormat = PixelFormat::PACKED_1;
 	bool bAppend = false;
 	int iTileW = 0;
 	int iTileH = 0;
-	eLoadImageMode loadImageMode = eLoadImageMode::DEFAULT;
+	LoadImageScale loadImageScale;
+	int64_t iMaxMem = 0; // 0 = no budget
 
 	std::string header;
 };
@@ -52,8 +61,11 @@ static int ParseArgs( int argc, char** argv, OptionsExport& opt )
 	{
 		NONE,
 		OPT_SHIFT,
+		OPT_SHIFTS,
 		OPT_PIXEL_FORMAT,
 		OPT_TILE,
+		OPT_SCALE,
+		OPT_MAXMEM,
 	};
 
 	eOption specialNextArg = NONE;
@@ -100,6 +112,30 @@ static int ParseArgs( int argc, char** argv, OptionsExport& opt )
 
 				break;
 
+			case OPT_SCALE:
+
+				if ( DecodeLoadImageScale( pArg, opt.loadImageScale ) == false )
+				{
+					// error.
+					PrintError( "Invalid -scale parameter \"%s\". Must be NxM, each 1 - 16.", pArg );
+					return 1;
+				}
+
+				break;
+
+			case OPT_MAXMEM:
+
+				opt.iMaxMem = ParseSizeWithSuffix( pArg );
+
+				if ( opt.iMaxMem <= 0 )
+				{
+					// error.
+					PrintError( "Invalid -maxmem parameter \"%s\".", pArg );
+					return 1;
+				}
+
+				break;
+
 			case OPT_PIXEL_FORMAT:
 
 				opt.dataOutFormat = DecodePixelFormat( pArg );
@@ -122,7 +158,7 @@ static int ParseArgs( int argc, char** argv, OptionsExport& opt )
 
 					if ( iValue >= 0 )
 					{
-						opt.iShift = iValue;
+						opt.shifts = { iValue };
 					}
 					else if ( *pEnd != 0 )
 					{
@@ -140,16 +176,35 @@ static int ParseArgs( int argc, char** argv, OptionsExport& opt )
 
 				break;
 
+			case OPT_SHIFTS:
+
+				if ( DecodeShifts( pArg, opt.shifts ) == false )
+				{
+					// error.
+					PrintError( "Invalid -shifts parameter \"%s\". Must be shifts or ranges of 0 - 255, e.g. 0-7.", pArg );
+					return 1;
+				}
+
+				break;
+
 			}
 
 			specialNextArg = NONE;
 		}
-		else if ( *pArg == '-' )
+		else if ( *pArg == '-' && pArg[ 1 ] != 0 ) // "-" alone is stdin / stdout
 		{
 			if ( _stricmp( pArg, "-shift" ) == 0 )
 			{
 				specialNextArg = OPT_SHIFT;
 			}
+			else if ( _stricmp( pArg, "-shifts" ) == 0 )
+			{
+				specialNextArg = OPT_SHIFTS;
+			}
+			else if ( _stricmp( pArg, "-allshifts" ) == 0 )
+			{
+				opt.bAllShifts = true;
+			}
 			else if ( _stricmp( pArg, "-pf" ) == 0 )
 			{
 				specialNextArg = OPT_PIXEL_FORMAT;
@@ -164,7 +219,16 @@ static int ParseArgs( int argc, char** argv, OptionsExport& opt )
 			}
 			else if ( _stricmp( pArg, "-2x" ) == 0 )
 			{
-				opt.loadImageMode = eLoadImageMode::SCALE_2X;
+				opt.loadImageScale.x = 2;
+				opt.loadImageScale.y = 1;
+			}
+			else if ( _stricmp( pArg, "-scale" ) == 0 )
+			{
+				specialNextArg = OPT_SCALE;
+			}
+			else if ( _stricmp( pArg, "-maxmem" ) == 0 )
+			{
+				specialNextArg = OPT_MAXMEM;
 			}
 			else if ( pArg[ 1 ] == 'H' )
 			{
@@ -199,102 +263,230 @@ static int ParseArgs( int argc, char** argv, OptionsExport& opt )
 		return 1;
 	}
 
+	// Keep stdout for the output.
+	if ( IsStdStream( opt.pOutputName ) )
+	{
+		MessagesToStderr();
+	}
+
 	return 0; // OK
 }
 
 //==============================================================================
 
-static void BuildOutput( const Image& image, ImageInfo& imageInfo, const OptionsExport& opt, Image& output )
+// Instantiated once per output format (see DispatchPixelFormat). Builds one output
+// per shift in opt.shifts.
+template< typename TRAITS >
+static void BuildOutput( const Image& image, ImageInfo& imageInfo, const OptionsExport& opt, Image* pOutputs )
 {
 	// Border pixels are implicitly index zero. TODO: Customise option?
-	uint32_t borderValue = 0;
+	const uint8_t borderValue = 0;
 
-	if ( opt.iTileW )
+	const TileGrid grid( image, imageInfo, opt.iTileW, opt.iTileH );
+	const int iTileW = grid.iTileW;
+	const int iTileH = grid.iTileH;
+
+	// Rows are written out back to back, so keep them packed.
+	ImageLayout layout;
+	layout.rowAlign = 1;
+	layout.bHugePages = true;
+
+	const int shiftCount = static_cast< int >( opt.shifts.size() );
+	for ( int i = 0; i < shiftCount; ++i )
 	{
-		//
-		// -- TILE MODE
+		pOutputs[ i ].Create( opt.dataOutFormat, iTileW + opt.shifts[ i ], grid.GetRows(), layout );
+	}
 
-		int iTilesX = image.GetWidth() / opt.iTileW;
-		int iTilesY = image.GetHeight() / opt.iTileH;
+	Image& output = pOutputs[ 0 ];
+	const bool bShifted = shiftCount > 1 || opt.shifts[ 0 ] != 0;
 
-		output.Create( opt.dataOutFormat, opt.iTileW + opt.iShift, opt.iTileH * iTilesX * iTilesY );
+	// Staging row of indices covering the whole output stride. The right-hand padding
+	// is filled once, and never overwritten.
+	std::vector< uint8_t > row( output.GetStride(), borderValue );
 
-		// For each tile (row-major order)
-		for ( int ity = 0; ity < iTilesY; ++ity )
-		{
-			for ( int itx = 0; itx < iTilesX; ++itx )
-			{
-				// tile source position.
-				int index = itx + ity * iTilesX;
-				int src_x0 = itx * opt.iTileW;
-				int src_y0 = ity * opt.iTileH;
+	// Shifted rows are packed once, then shifted in the packed domain into each output.
+	// The pixels revealed on the left are filled from one packed unit of border.
+	const fnPackRow packRow = GetPackRowKernel( opt.dataOutFormat );
+	std::vector< uint8_t > packed( bShifted ? output.GetPitch() : 0 );
+	uint8_t fill[ 64 ];
+	if ( bShifted )
+	{
+		uint8_t border[ TRAITS::kUnitPixels ];
+		memset( border, borderValue, sizeof( border ) );
+		packRow( border, TRAITS::kUnitPixels, fill );
+	}
 
-				// output position
-				int dst_y0 = index * opt.iTileH;
+	// Whole 8x8 patterns are encoded straight from the source image.
+	const bool bPatterns = TRAITS::kIsPattern8x8 && iTileW == TRAITS::kTileW && iTileH == TRAITS::kTileH && bShifted == false;
 
-				// Copy tile
-				for ( int iy = 0; iy < opt.iTileH; ++iy )
-				{
-					const int y = dst_y0 + iy;
+	ForEachTile( ImageView( image ), grid, [ & ]( const ImageView& tile, int dst_y0 )
+	{
+		if ( bPatterns )
+		{
+			// Copy tile in one go.
+			output.PackTile8x8( dst_y0, tile );
+			return;
+		}
 
-					// clear space revealed by shifting
-					for ( int x = 0; x < opt.iShift; ++x )
-					{
-						output.Plot( x, y, borderValue );
-					}
+		// Copy tile
+		for ( int iy = 0; iy < iTileH; ++iy )
+		{
+			if ( bShifted )
+			{
+				// Pack the tile row, then apply each shift.
+				packRow( tile.GetRowPtr( iy ), iTileW, packed.data() );
+				for ( int i = 0; i < shiftCount; ++i )
+				{
+					pOutputs[ i ].ShiftRow( dst_y0 + iy, packed.data(), iTileW, opt.shifts[ i ], fill );
+				}
+				continue;
+			}
 
-					// copy tile row
-					for ( int x = 0; x < opt.iTileW; ++x )
-					{
-						// Read the pixel at this position.
-						uint32_t data = image.Peek( src_x0 + x, src_y0 + iy );
+			// Read the tile row.
+			memcpy( row.data(), tile.GetRowPtr( iy ), iTileW );
 
-						// Output to export. Apply shift. Excess bits are ignored.
-						output.Plot( x + opt.iShift, y, data );
-					}
+			// Output to export. Excess bits are ignored.
+			output.PackRow( dst_y0 + iy, row.data() );
+		}
+	} );
+}
 
-					// right-hand border, clear padding to end of allocated row
-					for ( int x = imageInfo.width + opt.iShift; x < output.GetStride(); ++x )
-					{
-						output.Plot( x, y, borderValue );
-					}
-				}
+// Rows per band when streaming a whole image.
+static const int kStreamRows = 32;
 
-			}; // for each source column
-		
-		}; // for each source row
+// Stream the image from the loader a band of rows at a time, building and writing
+// each band as it goes, so only one band of the image and its outputs is ever held.
+// Bands are whole rows of tiles in tile mode, or kStreamRows rows of the whole
+// image, unless -maxmem makes room for more. The first shift is written straight
+// to the file, and the rest are spilled to disk until it's done.
+static int StreamOutput( Loader& loader, const ImageInfo& imageInfo, OptionsExport& opt, int tileCount, int iTileHeight )
+{
+	int iUnitH, iDefaultH, iUsedH;
+	if ( opt.iTileW )
+	{
+		// Rows past the last whole tile are never read.
+		iUnitH = opt.iTileH;
+		iDefaultH = opt.iTileH;
+		iUsedH = ( imageInfo.height / opt.iTileH ) * opt.iTileH;
 	}
 	else
 	{
-		//
-		// -- WHOLE IMAGE
+		// Patterns are only this way when the image is exactly one pattern.
+		iUnitH = PixelFormatIsPattern8x8( opt.dataOutFormat ) ? imageInfo.height : 1;
+		iDefaultH = std::max( iUnitH, kStreamRows );
+		iUsedH = imageInfo.height;
+	}
 
-		output.Create( opt.dataOutFormat, imageInfo.width + opt.iShift, imageInfo.height );
+	const int shiftCount = static_cast< int >( opt.shifts.size() );
+	const int iBandH = StreamBandHeight( opt.iMaxMem, imageInfo.width, iUsedH, iUnitH, iDefaultH, shiftCount );
 
-		for ( uint32_t y = 0; y < imageInfo.height; ++y )
+	// An unshifted whole image is the band, so each row is decoded straight into
+	// the output format. Anything else is built from a band of indices.
+	const bool bDirect = opt.iTileW == 0 && shiftCount == 1 && opt.shifts[ 0 ] == 0 && PixelFormatIsPattern8x8( opt.dataOutFormat ) == false;
+
+	// Room for the SIMD kernels at the end of each row.
+	ImageLayout layout;
+	layout.rowPadding = 64;
+
+	// Direct rows are written out back to back, so keep them packed.
+	ImageLayout directLayout;
+	directLayout.rowAlign = 1;
+	directLayout.bHugePages = true;
+
+	Image band;
+	ImageInfo bandInfo = imageInfo;
+	std::vector< Image > outputs( shiftCount );
+	std::vector< FileWriter > files( shiftCount );
+	int result = 0;
+
+	for ( int y0 = 0; y0 < iUsedH && result == 0; y0 += iBandH )
+	{
+		const uint32_t iRows = static_cast< uint32_t >( std::min( iBandH, iUsedH - y0 ) );
+		Image& target = bDirect ? outputs[ 0 ] : band;
+		if ( target.GetHeight() != iRows )
 		{
-			// clear space revealed by shifting
-			for ( int x = 0; x < opt.iShift; ++x )
+			if ( bDirect )
 			{
-				output.Plot( x, y, borderValue );
+				target.Create( opt.dataOutFormat, imageInfo.width, iRows, directLayout );
 			}
+			else
+			{
+				target.Create( PixelFormat::CHUNKY_8, imageInfo.width, iRows, layout );
+			}
+			bandInfo.height = iRows;
+		}
 
-			for ( uint32_t x = 0; x < imageInfo.width; ++x )
+		for ( uint32_t y = 0; y < iRows && result == 0; ++y )
+		{
+			const bool bRead = bDirect ? loader.ReadRow( target, y ) : loader.ReadRow( target.GetRowPtr( y ) );
+			if ( bRead == false )
 			{
-				// Read the index at this position.
-				uint32_t data = image.Peek( x, y );
+				PrintError( "Failed to read image." );
+				result = 1; // ERROR
+			}
+		}
+
+		if ( result )
+		{
+			break;
+		}
 
-				// Output to export. Apply shift. Excess bits are ignored.
-				output.Plot( x + opt.iShift, y, data );
+		if ( bDirect == false )
+		{
+			DispatchPixelFormat( opt.dataOutFormat, [ & ]( auto traits )
+			{
+				BuildOutput< decltype( traits ) >( band, bandInfo, opt, outputs.data() );
+			} );
+		}
+
+		// The first band sets up the files.
+		if ( y0 == 0 )
+		{
+			bool bOpen = OpenOutput_Fbin( files[ 0 ], opt.pOutputName, opt.bAppend );
+			for ( int i = 1; i < shiftCount && bOpen; ++i )
+			{
+				bOpen = OpenSpill_Fbin( files[ i ] );
 			}
 
-			// right-hand border, clear padding to end of allocated row
-			for ( int x = imageInfo.width + opt.iShift; x < output.GetStride(); ++x )
+			if ( bOpen == false )
 			{
-				output.Plot( x, y, borderValue );
+				result = 1; // ERROR
+				break;
 			}
+
+			BeginImage_Fbin( files[ 0 ], outputs[ 0 ], opt.header, opt.bAppend, tileCount, iTileHeight );
+		}
+
+		for ( int i = 0; i < shiftCount; ++i )
+		{
+			WriteImage( outputs[ i ], files[ i ] );
 		}
 	}
+
+	if ( result == 0 )
+	{
+		result = EndImage_Fbin( files[ 0 ] );
+
+		// Follow on with each spilled shift.
+		for ( int i = 1; i < shiftCount && result == 0; ++i )
+		{
+			BeginImage_Fbin( files[ 0 ], outputs[ i ], opt.header, true, tileCount, iTileHeight );
+
+			result = CopySpill_Fbin( files[ i ], files[ 0 ] );
+			if ( result == 0 )
+			{
+				result = EndImage_Fbin( files[ 0 ] );
+			}
+		}
+	}
+
+	// Only now is the output file replaced.
+	if ( result == 0 )
+	{
+		result = CloseOutput_Fbin( files[ 0 ] );
+	}
+
+	return result;
 }
 
 //==============================================================================
@@ -307,6 +499,8 @@ int Export( int argc, char** argv )
 	OptionsExport opt;
 	Image image;
 	ImageInfo imageInfo;
+	FileReader reader;
+	Loader loader;
 
 	// Get options
 	if ( ParseArgs( argc, argv, opt ) )
@@ -315,20 +509,28 @@ int Export( int argc, char** argv )
 	}
 
 	// Validate load mode.
-	ValidateLoadImageMode( opt.dataOutFormat, opt.loadImageMode );
+	ValidateLoadImageScale( opt.dataOutFormat, opt.loadImageScale );
+
+	// A single output is streamed a band at a time. Several shifts are only streamed
+	// under -maxmem, as they're spilled to disk. Otherwise the image is loaded up front.
+	const bool bStream = opt.iMaxMem > 0 || ( opt.bAllShifts == false && opt.shifts.size() == 1 );
 
 	// Load image
-	if ( LoadImage( opt.pInputName, image, imageInfo, opt.loadImageMode ) )
+	if ( bStream )
 	{
-		return 1; // ERROR
+		if ( OpenImageRows( opt.pInputName, reader, loader, imageInfo, opt.loadImageScale ) )
+		{
+			return 1; // ERROR
+		}
 	}
-
-	// Within acceptable maximum index?
-	const uint32_t uMaxPermittedIndex = PixelFormatMaxIndex( opt.dataOutFormat );
-	if ( uMaxPermittedIndex > 0 && imageInfo.uMaxIndex >= uMaxPermittedIndex )
+	else
 	{
-		Info( "WARNING: Image contains an index (#%d) which exceeds the maximum limit.\n", imageInfo.uMaxIndex );
-		Info( "WARNING: Pixel format requires indices from 0 to %d.\n", uMaxPermittedIndex - 1 );
+		if ( LoadImage( opt.pInputName, image, imageInfo, opt.loadImageScale ) )
+		{
+			return 1; // ERROR
+		}
+
+		CheckMaxIndex( imageInfo, opt.dataOutFormat );
 	}
 
 	// Silently enabled tiled mode?
@@ -342,15 +544,18 @@ int Export( int argc, char** argv )
 	}
 
 	// Build output
-	Image output;
 	Info( "Exporting '%s' format raw image.\n", PixelFormatToString( opt.dataOutFormat ) );
 	
 	// Shift / validated
-	ValidateShift( opt.dataOutFormat, opt.iShift );
-	if ( opt.iShift )
+	if ( opt.bAllShifts )
 	{
-		Info( "Output is shifted right by %d pixels.\n", opt.iShift );
+		opt.shifts = AllShifts( opt.dataOutFormat );
 	}
+	ValidateShift( opt.dataOutFormat, opt.shifts );
+	PrintShifts( opt.shifts );
+
+	std::vector< Image > outputs( opt.shifts.size() );
+	Image& output = outputs[ 0 ];
 
 	int tileCount;
 	if ( opt.iTileW )
@@ -372,15 +577,41 @@ int Export( int argc, char** argv )
 		opt.iTileH = output.GetHeight();
 	}
 
-	BuildOutput( image, imageInfo, opt, output );
+	if ( bStream )
+	{
+		const int result = StreamOutput( loader, imageInfo, opt, tileCount, opt.iTileH );
+
+		// Only known once every row is read, so not after a failure.
+		if ( result == 0 )
+		{
+			CheckMaxIndex( imageInfo, opt.dataOutFormat );
+		}
+
+		return result;
+	}
+
+	DispatchPixelFormat( opt.dataOutFormat, [ & ]( auto traits )
+	{
+		BuildOutput< decltype( traits ) >( image, imageInfo, opt, outputs.data() );
+	} );
 
-	// Write output
-	if ( WriteImage_Fbin( output, opt.pOutputName, opt.header, opt.bAppend, tileCount, opt.iTileH ) )
+	// Write output, one shift after another.
+	FileWriter out;
+	if ( OpenOutput_Fbin( out, opt.pOutputName, opt.bAppend ) == false )
 	{
 		return 1; // ERROR
 	}
 
-	return 0;
+	for ( size_t i = 0; i < outputs.size(); ++i )
+	{
+		if ( WriteImage_Fbin( out, outputs[ i ], opt.header, opt.bAppend || i > 0, tileCount, opt.iTileH ) )
+		{
+			return 1; // ERROR
+		}
+	}
+
+	// Only now is the output file replaced.
+	return CloseOutput_Fbin( out );
 }
 
 //==============================================================================
@@ -24,18 +24,26 @@ SOFTWARE.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "utils.h"
 #include "Image.h"
 #include "ImageInfo.h"
+#include "IndexSet.h"
+#include "FileReader.h"
+#include "FileWriter.h"
+#include "Loader.h"
 
 //==============================================================================
 
 struct OptionsMask
 {
-	int iMaskIndex = 0;
-	int iShift = 0;
+	IndexSet maskIndices = IndexSet( 0 );
+	std::vector< int > shifts = { 0 }; // one output per shift
+	bool bAllShifts = false;
 	const char* pInputName = nullptr;
 	const char* pOutputName = nullptr;
 	PixelFormat dataOutFormat = PixelFormat::PACKED_1;
@@ -43,7 +51,8 @@ struct OptionsMask
 	bool bInvert = false;
 	int iTileW = 0;
 	int iTileH = 0;
-	eLoadImageMode loadImageMode = eLoadImageMode::DEFAULT;
+	LoadImageScale loadImageScale;
+	int64_t iMaxMem = 0; // 0 = no budget
 
 	std::string header;
 };
@@ -55,8 +64,11 @@ static int ParseArgs( int argc, char** argv, OptionsMask& opt )
 		NONE,
 		OPT_INDEX,
 		OPT_SHIFT,
+		OPT_SHIFTS,
 		OPT_PIXEL_FORMAT,
 		OPT_TILE,
+		OPT_SCALE,
+		OPT_MAXMEM,
 	};
 
 	eOption specialNextArg = NONE;
@@ -103,6 +115,30 @@ static int ParseArgs( int argc, char** argv, OptionsMask& opt )
 
 				break;
 
+			case OPT_SCALE:
+
+				if ( DecodeLoadImageScale( pArg, opt.loadImageScale ) == false )
+				{
+					// error.
+					PrintError( "Invalid -scale parameter \"%s\". Must be NxM, each 1 - 16.", pArg );
+					return 1;
+				}
+
+				break;
+
+			case OPT_MAXMEM:
+
+				opt.iMaxMem = ParseSizeWithSuffix( pArg );
+
+				if ( opt.iMaxMem <= 0 )
+				{
+					// error.
+					PrintError( "Invalid -maxmem parameter \"%s\".", pArg );
+					return 1;
+				}
+
+				break;
+
 			case OPT_PIXEL_FORMAT:
 
 				opt.dataOutFormat = DecodePixelFormat( pArg );
@@ -125,7 +161,7 @@ static int ParseArgs( int argc, char** argv, OptionsMask& opt )
 
 					if ( iValue >= 0 )
 					{
-						opt.iShift = iValue;
+						opt.shifts = { iValue };
 					}
 					else if ( *pEnd != 0 )
 					{
@@ -145,27 +181,22 @@ static int ParseArgs( int argc, char** argv, OptionsMask& opt )
 
 			case OPT_INDEX:
 
+				if ( DecodeIndexSet( pArg, opt.maskIndices ) == false )
 				{
-					int iValue;
-					char* pEnd = nullptr;
-					iValue = strtol( pArg, &pEnd, 10 );
+					// error.
+					PrintError( "Invalid -index parameter \"%s\". Must be indices or ranges of 0 - 255, e.g. 0,3,7-9.", pArg );
+					return 1;
+				}
 
-					if ( iValue >= 0 )
-					{
-						opt.iMaskIndex = iValue;
-					}
-					else if ( *pEnd != 0 )
-					{
-						// error.
-						PrintError( "Invalid -index parameter \"%s\".", pArg );
-						return 1;
-					}
-					else
-					{
-						// error.
-						PrintError( "Invalid -index %d. Must be 0 - 255.", iValue );
-						return 1;
-					}
+				break;
+
+			case OPT_SHIFTS:
+
+				if ( DecodeShifts( pArg, opt.shifts ) == false )
+				{
+					// error.
+					PrintError( "Invalid -shifts parameter \"%s\". Must be shifts or ranges of 0 - 255, e.g. 0-7.", pArg );
+					return 1;
 				}
 
 				break;
@@ -174,7 +205,7 @@ static int ParseArgs( int argc, char** argv, OptionsMask& opt )
 
 			specialNextArg = NONE;
 		}
-		else if ( *pArg == '-' )
+		else if ( *pArg == '-' && pArg[ 1 ] != 0 ) // "-" alone is stdin / stdout
 		{
 			if ( _stricmp( pArg, "-index" ) == 0 )
 			{
@@ -184,6 +215,14 @@ static int ParseArgs( int argc, char** argv, OptionsMask& opt )
 			{
 				specialNextArg = OPT_SHIFT;
 			}
+			else if ( _stricmp( pArg, "-shifts" ) == 0 )
+			{
+				specialNextArg = OPT_SHIFTS;
+			}
+			else if ( _stricmp( pArg, "-allshifts" ) == 0 )
+			{
+				opt.bAllShifts = true;
+			}
 			else if ( _stricmp( pArg, "-pf" ) == 0 )
 			{
 				specialNextArg = OPT_PIXEL_FORMAT;
@@ -198,7 +237,16 @@ static int ParseArgs( int argc, char** argv, OptionsMask& opt )
 			}
 			else if ( _stricmp( pArg, "-2x" ) == 0 )
 			{
-				opt.loadImageMode = eLoadImageMode::SCALE_2X;
+				opt.loadImageScale.x = 2;
+				opt.loadImageScale.y = 1;
+			}
+			else if ( _stricmp( pArg, "-scale" ) == 0 )
+			{
+				specialNextArg = OPT_SCALE;
+			}
+			else if ( _stricmp( pArg, "-maxmem" ) == 0 )
+			{
+				specialNextArg = OPT_MAXMEM;
 			}
 			else if ( _stricmp( pArg, "-not" ) == 0 )
 			{
@@ -237,125 +285,186 @@ static int ParseArgs( int argc, char** argv, OptionsMask& opt )
 		return 1;
 	}
 
+	// Keep stdout for the output.
+	if ( IsStdStream( opt.pOutputName ) )
+	{
+		MessagesToStderr();
+	}
+
 	return 0; // OK
 }
 
 //==============================================================================
 
-static void BuildMask( const Image& image, ImageInfo& imageInfo, const OptionsMask& opt, Image& output )
+// Builds one output per shift in opt.shifts.
+static void BuildMask( const Image& image, ImageInfo& imageInfo, const OptionsMask& opt, Image* pOutputs )
 {
-	// Border pixels are implicitly index zero. TODO: Customise option?
-	uint32_t borderValue;
-	borderValue = ( 0 == opt.iMaskIndex ) ? UINT32_MAX : 0;
+	const TileGrid grid( image, imageInfo, opt.iTileW, opt.iTileH );
+	const int iTileW = grid.iTileW;
+	const int iTileH = grid.iTileH;
 
-	if ( opt.iTileW )
+	// Rows are written out back to back, so keep them packed.
+	ImageLayout layout;
+	layout.rowAlign = 1;
+	layout.bHugePages = true;
+
+	const int shiftCount = static_cast< int >( opt.shifts.size() );
+	for ( int i = 0; i < shiftCount; ++i )
 	{
-		//
-		// -- TILE MODE
+		pOutputs[ i ].Create( opt.dataOutFormat, iTileW + opt.shifts[ i ], grid.GetRows(), layout );
+	}
 
-		int iTilesX = image.GetWidth() / opt.iTileW;
-		int iTilesY = image.GetHeight() / opt.iTileH;
+	Image& output = pOutputs[ 0 ];
+	const bool bShifted = shiftCount > 1 || opt.shifts[ 0 ] != 0;
 
-		output.Create( opt.dataOutFormat, opt.iTileW + opt.iShift, opt.iTileH * iTilesX * iTilesY );
+	// Shifted rows are masked once, then shifted in the packed domain into each output.
+	// The pixels revealed on the left are filled from one packed unit of border. Border
+	// pixels are implicitly index zero. TODO: Customise option?
+	const fnMaskRow maskRow = GetMaskRowKernel( opt.dataOutFormat );
+	std::vector< uint8_t > packed( bShifted ? output.GetPitch() : 0 );
+	uint8_t fill[ 64 ];
+	if ( bShifted )
+	{
+		const uint8_t border[ 16 ] = {};
+		maskRow( border, 16, opt.maskIndices, opt.bInvert, fill );
+	}
 
-		// For each tile (row-major order)
-		for ( int ity = 0; ity < iTilesY; ++ity )
+	ForEachTile( ImageView( image ), grid, [ & ]( const ImageView& tile, int dst_y0 )
+	{
+		for ( int iy = 0; iy < iTileH; ++iy )
 		{
-			for ( int itx = 0; itx < iTilesX; ++itx )
-			{
-				// tile source position.
-				int index = itx + ity * iTilesX;
-				int src_x0 = itx * opt.iTileW;
-				int src_y0 = ity * opt.iTileH;
+			const uint8_t* pSrc = tile.GetRowPtr( iy );
 
-				// output position
-				int dst_y0 = index * opt.iTileH;
-
-				// Copy tile
-				for ( int iy = 0; iy < opt.iTileH; ++iy )
+			if ( bShifted == false )
+			{
+				// Test, invert and pack in one pass. Patterns are written row by row.
+				output.MaskRow( dst_y0 + iy, pSrc, opt.maskIndices, opt.bInvert );
+			}
+			else
+			{
+				// Mask the tile row, then apply each shift.
+				maskRow( pSrc, iTileW, opt.maskIndices, opt.bInvert, packed.data() );
+				for ( int i = 0; i < shiftCount; ++i )
 				{
-					const int y = dst_y0 + iy;
-
-					// clear space revealed by shifting
-					for ( int x = 0; x < opt.iShift; ++x )
-					{
-						output.Plot( x, y, borderValue );
-					}
+					pOutputs[ i ].ShiftRow( dst_y0 + iy, packed.data(), iTileW, opt.shifts[ i ], fill );
+				}
+			}
+		}
+	} );
+}
 
-					// copy tile row
-					for ( int x = 0; x < opt.iTileW; ++x )
-					{
-						// Read the pixel at this position.
-						uint32_t data = image.Peek( src_x0 + x, src_y0 + iy );
+// Rows per band when streaming a whole image.
+static const int kStreamRows = 32;
 
-						// Output to export. Apply shift. Excess bits are ignored.
-						output.Plot( x + opt.iShift, y, data );
-					}
+// Stream the image from the loader a band of rows at a time, building and writing
+// each band as it goes, so only one band of the image and its masks is ever held.
+// Bands are whole rows of tiles in tile mode, or kStreamRows rows of the whole
+// image, unless -maxmem makes room for more. The first shift is written straight
+// to the file, and the rest are spilled to disk until it's done.
+static int StreamMask( Loader& loader, const ImageInfo& imageInfo, OptionsMask& opt, int tileCount, int iTileHeight )
+{
+	int iUnitH, iDefaultH, iUsedH;
+	if ( opt.iTileW )
+	{
+		// Rows past the last whole tile are never read.
+		iUnitH = opt.iTileH;
+		iDefaultH = opt.iTileH;
+		iUsedH = ( imageInfo.height / opt.iTileH ) * opt.iTileH;
+	}
+	else
+	{
+		// Patterns are only this way when the image is exactly one pattern.
+		iUnitH = PixelFormatIsPattern8x8( opt.dataOutFormat ) ? imageInfo.height : 1;
+		iDefaultH = std::max( iUnitH, kStreamRows );
+		iUsedH = imageInfo.height;
+	}
 
-					// right-hand border, clear padding to end of allocated row
-					for ( int x = imageInfo.width + opt.iShift; x < output.GetStride(); ++x )
-					{
-						output.Plot( x, y, borderValue );
-					}
+	const int shiftCount = static_cast< int >( opt.shifts.size() );
+	const int iBandH = StreamBandHeight( opt.iMaxMem, imageInfo.width, iUsedH, iUnitH, iDefaultH, shiftCount );
 
-					// Invert?
-					if ( opt.bInvert )
-					{
-						uint8_t* pRow = output.GetRowPtr( y );
-						for ( int count = output.GetPitch(); count--; ++pRow )
-						{
-							*pRow = ~( *pRow );
-						}
-					}
-				}
+	// Room for the SIMD kernels at the end of each row.
+	ImageLayout layout;
+	layout.rowPadding = 64;
 
-			}; // for each source column
+	Image band;
+	ImageInfo bandInfo = imageInfo;
+	std::vector< Image > masks( shiftCount );
+	std::vector< FileWriter > files( shiftCount );
+	int result = 0;
 
-		}; // for each source row
-	}
-	else
+	for ( int y0 = 0; y0 < iUsedH && result == 0; y0 += iBandH )
 	{
-		//
-		// -- WHOLE IMAGE
-		output.Create( opt.dataOutFormat, imageInfo.width + opt.iShift, imageInfo.height );
+		const uint32_t iRows = static_cast< uint32_t >( std::min( iBandH, iUsedH - y0 ) );
+		if ( band.GetHeight() != iRows )
+		{
+			band.Create( PixelFormat::CHUNKY_8, imageInfo.width, iRows, layout );
+			bandInfo.height = iRows;
+		}
 
-		for ( uint32_t y = 0; y < imageInfo.height; ++y )
+		for ( uint32_t y = 0; y < iRows && result == 0; ++y )
 		{
-			// clear space revealed by shifting
-			for ( int x = 0; x < opt.iShift; ++x )
+			if ( loader.ReadRow( band.GetRowPtr( y ) ) == false )
 			{
-				output.Plot( x, y, borderValue );
+				PrintError( "Failed to read image." );
+				result = 1; // ERROR
 			}
+		}
 
-			for ( uint32_t x = 0; x < imageInfo.width; ++x )
-			{
-				// Read the index at this position.
-				uint32_t data = image.Peek( x, y );
+		if ( result )
+		{
+			break;
+		}
 
-				// Is this the matching index? If so, output a 1, otherwise 0.
-				data = ( data == opt.iMaskIndex ) ? UINT32_MAX : 0;
+		BuildMask( band, bandInfo, opt, masks.data() );
 
-				// Output to mask. Apply shift. Excess bits are ignored.
-				output.Plot( x + opt.iShift, y, data );
+		// The first band sets up the files.
+		if ( y0 == 0 )
+		{
+			bool bOpen = OpenOutput_Fbin( files[ 0 ], opt.pOutputName, opt.bAppend );
+			for ( int i = 1; i < shiftCount && bOpen; ++i )
+			{
+				bOpen = OpenSpill_Fbin( files[ i ] );
 			}
 
-			// right-hand border, clear padding to end of allocated row
-			for ( int x = imageInfo.width + opt.iShift; x < output.GetStride(); ++x )
+			if ( bOpen == false )
 			{
-				output.Plot( x, y, borderValue );
+				result = 1; // ERROR
+				break;
 			}
 
-			// Invert?
-			if ( opt.bInvert )
+			BeginImage_Fbin( files[ 0 ], masks[ 0 ], opt.header, opt.bAppend, tileCount, iTileHeight );
+		}
+
+		for ( int i = 0; i < shiftCount; ++i )
+		{
+			WriteImage( masks[ i ], files[ i ] );
+		}
+	}
+
+	if ( result == 0 )
+	{
+		result = EndImage_Fbin( files[ 0 ] );
+
+		// Follow on with each spilled shift.
+		for ( int i = 1; i < shiftCount && result == 0; ++i )
+		{
+			BeginImage_Fbin( files[ 0 ], masks[ i ], opt.header, true, tileCount, iTileHeight );
+
+			result = CopySpill_Fbin( files[ i ], files[ 0 ] );
+			if ( result == 0 )
 			{
-				uint8_t* pRow = output.GetRowPtr( y );
-				for ( int count = output.GetPitch(); count--; ++pRow )
-				{
-					*pRow = ~( *pRow );
-				}
+				result = EndImage_Fbin( files[ 0 ] );
 			}
 		}
 	}
+
+	// Only now is the output file replaced.
+	if ( result == 0 )
+	{
+		result = CloseOutput_Fbin( files[ 0 ] );
+	}
+
+	return result;
 }
 
 //==============================================================================
@@ -368,6 +477,8 @@ int Mask( int argc, char** argv )
 	OptionsMask opt;
 	Image image;
 	ImageInfo imageInfo;
+	FileReader reader;
+	Loader loader;
 
 	// Get options
 	if ( ParseArgs( argc, argv, opt ) )
@@ -376,24 +487,38 @@ int Mask( int argc, char** argv )
 	}
 
 	// Validate load mode.
-	ValidateLoadImageMode( opt.dataOutFormat, opt.loadImageMode );
+	ValidateLoadImageScale( opt.dataOutFormat, opt.loadImageScale );
+
+	// A single mask is streamed a band at a time. Several shifts are only streamed
+	// under -maxmem, as they're spilled to disk. Otherwise the image is loaded up front.
+	const bool bStream = opt.iMaxMem > 0 || ( opt.bAllShifts == false && opt.shifts.size() == 1 );
 
 	// Load image
-	if ( LoadImage( opt.pInputName, image, imageInfo, opt.loadImageMode ) )
+	if ( bStream )
+	{
+		if ( OpenImageRows( opt.pInputName, reader, loader, imageInfo, opt.loadImageScale ) )
+		{
+			return 1; // ERROR
+		}
+	}
+	else if ( LoadImage( opt.pInputName, image, imageInfo, opt.loadImageScale ) )
 	{
 		return 1; // ERROR
 	}
 
 	// Build mask
-	Image mask;
-	Info( "Generating '%s' format mask from palette index %d.\n", PixelFormatToString( opt.dataOutFormat ), opt.iMaskIndex );
+	Info( "Generating '%s' format mask from palette index %s.\n", PixelFormatToString( opt.dataOutFormat ), IndexSetToString( opt.maskIndices ).c_str() );
 	
 	// Shift / validated
-	ValidateShift( opt.dataOutFormat, opt.iShift );
-	if ( opt.iShift )
+	if ( opt.bAllShifts )
 	{
-		Info( "Output is shifted right by %d pixels.\n", opt.iShift );
+		opt.shifts = AllShifts( opt.dataOutFormat );
 	}
+	ValidateShift( opt.dataOutFormat, opt.shifts );
+	PrintShifts( opt.shifts );
+
+	std::vector< Image > masks( opt.shifts.size() );
+	Image& mask = masks[ 0 ];
 
 	// Silently enabled tiled mode?
 	if ( PixelFormatIsPattern8x8( opt.dataOutFormat ) )
@@ -425,15 +550,30 @@ int Mask( int argc, char** argv )
 		opt.iTileH = mask.GetHeight();
 	}
 
-	BuildMask( image, imageInfo, opt, mask );
+	if ( bStream )
+	{
+		return StreamMask( loader, imageInfo, opt, tileCount, opt.iTileH );
+	}
+
+	BuildMask( image, imageInfo, opt, masks.data() );
 
-	// Write output
-	if ( WriteImage_Fbin( mask, opt.pOutputName, opt.header, opt.bAppend, tileCount, opt.iTileH ) )
+	// Write output, one shift after another.
+	FileWriter out;
+	if ( OpenOutput_Fbin( out, opt.pOutputName, opt.bAppend ) == false )
 	{
 		return 1; // ERROR
 	}
 
-	return 0;
+	for ( size_t i = 0; i < masks.size(); ++i )
+	{
+		if ( WriteImage_Fbin( out, masks[ i ], opt.header, opt.bAppend || i > 0, tileCount, opt.iTileH ) )
+		{
+			return 1; // ERROR
+		}
+	}
+
+	// Only now is the output file replaced.
+	return CloseOutput_Fbin( out );
 }
 
 //==============================================================================
@@ -0,0 +1,573 @@
+/*
+
+Copyright (c) 2021 David Walters
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+#include "Image.h"
+#include "ImageView.h"
+#include "ImageInfo.h"
+#include "IndexSet.h"
+#include "PixelFormatTraits.h"
+#include "RowKernels.h"
+#include "FileWriter.h"
+
+//==============================================================================
+
+// How the mask and the pixel data are woven together.
+enum class eInterleave
+{
+	BYTE,		// mask byte, data byte, ...
+	WORD,		// mask word, data word, ...
+	ROW,		// mask row, data row, ...
+	PLANE,		// one mask plane, then every data plane of the unit, ...
+};
+
+struct OptionsSprite
+{
+	IndexSet maskIndices = IndexSet( 0 );
+	std::vector< int > shifts = { 0 }; // one output per shift
+	bool bAllShifts = false;
+	const char* pInputName = nullptr;
+	const char* pOutputName = nullptr;
+	PixelFormat dataOutFormat = PixelFormat::PACKED_1;
+	eInterleave interleave = eInterleave::BYTE;
+	bool bAppend = false;
+	bool bInvert = false;
+	int iTileW = 0;
+	int iTileH = 0;
+	LoadImageScale loadImageScale;
+
+	std::string header;
+};
+
+static bool DecodeInterleave( const char* pString, eInterleave& interleave )
+{
+	if ( _stricmp( pString, "byte" ) == 0 )
+	{
+		interleave = eInterleave::BYTE;
+	}
+	else if ( _stricmp( pString, "word" ) == 0 )
+	{
+		interleave = eInterleave::WORD;
+	}
+	else if ( _stricmp( pString, "row" ) == 0 )
+	{
+		interleave = eInterleave::ROW;
+	}
+	else if ( _stricmp( pString, "plane" ) == 0 )
+	{
+		interleave = eInterleave::PLANE;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+static int ParseArgs( int argc, char** argv, OptionsSprite& opt )
+{
+	enum eOption
+	{
+		NONE,
+		OPT_INDEX,
+		OPT_SHIFT,
+		OPT_SHIFTS,
+		OPT_PIXEL_FORMAT,
+		OPT_TILE,
+		OPT_SCALE,
+		OPT_INTERLEAVE,
+	};
+
+	eOption specialNextArg = NONE;
+
+	// defaults.
+
+	// parse arguments (after the tool name)
+	for ( int i = 2; i < argc; ++i )
+	{
+		const char* pArg = argv[ i ];
+
+		if ( specialNextArg != NONE )
+		{
+			switch ( specialNextArg )
+			{
+
+			case OPT_TILE:
+
+				{
+					int iValue;
+					char* pEnd = nullptr;
+					iValue = strtol( pArg, &pEnd, 10 );
+
+					if ( iValue > 0 )
+					{
+						opt.iTileW = iValue;
+
+						pEnd++;
+
+						iValue = strtol( pEnd, nullptr, 10 );
+						if ( iValue > 0 )
+						{
+							opt.iTileH = iValue;
+						}
+					}
+
+					if ( opt.iTileW == 0 || opt.iTileH == 0 )
+					{
+						// error.
+						PrintError( "Invalid -tile parameter \"%s\".", pArg );
+						return 1;
+					}
+				}
+
+				break;
+
+			case OPT_SCALE:
+
+				if ( DecodeLoadImageScale( pArg, opt.loadImageScale ) == false )
+				{
+					// error.
+					PrintError( "Invalid -scale parameter \"%s\". Must be NxM, each 1 - 16.", pArg );
+					return 1;
+				}
+
+				break;
+
+			case OPT_PIXEL_FORMAT:
+
+				opt.dataOutFormat = DecodePixelFormat( pArg );
+
+				if ( opt.dataOutFormat == PixelFormat::UNKNOWN )
+				{
+					// error.
+					PrintError( "Invalid -pf parameter \"%s\".", pArg );
+					return 1;
+				}
+
+				break;
+
+			case OPT_SHIFT:
+
+				{
+					int iValue;
+					char* pEnd = nullptr;
+					iValue = strtol( pArg, &pEnd, 10 );
+
+					if ( iValue >= 0 )
+					{
+						opt.shifts = { iValue };
+					}
+					else if ( *pEnd != 0 )
+					{
+						// error.
+						PrintError( "Invalid -shift parameter \"%s\".", pArg );
+						return 1;
+					}
+					else
+					{
+						// error.
+						PrintError( "Invalid -shift %d. Must be 0 - 255.", iValue );
+						return 1;
+					}
+				}
+
+				break;
+
+			case OPT_INDEX:
+
+				if ( DecodeIndexSet( pArg, opt.maskIndices ) == false )
+				{
+					// error.
+					PrintError( "Invalid -index parameter \"%s\". Must be indices or ranges of 0 - 255, e.g. 0,3,7-9.", pArg );
+					return 1;
+				}
+
+				break;
+
+			case OPT_SHIFTS:
+
+				if ( DecodeShifts( pArg, opt.shifts ) == false )
+				{
+					// error.
+					PrintError( "Invalid -shifts parameter \"%s\". Must be shifts or ranges of 0 - 255, e.g. 0-7.", pArg );
+					return 1;
+				}
+
+				break;
+
+			case OPT_INTERLEAVE:
+
+				if ( DecodeInterleave( pArg, opt.interleave ) == false )
+				{
+					// error.
+					PrintError( "Invalid -interleave parameter \"%s\". Must be byte, word, row or plane.", pArg );
+					return 1;
+				}
+
+				break;
+
+			case NONE:
+
+				break;
+
+			}
+
+			specialNextArg = NONE;
+		}
+		else if ( *pArg == '-' && pArg[ 1 ] != 0 ) // "-" alone is stdin / stdout
+		{
+			if ( _stricmp( pArg, "-index" ) == 0 )
+			{
+				specialNextArg = OPT_INDEX;
+			}
+			else if ( _stricmp( pArg, "-shift" ) == 0 )
+			{
+				specialNextArg = OPT_SHIFT;
+			}
+			else if ( _stricmp( pArg, "-shifts" ) == 0 )
+			{
+				specialNextArg = OPT_SHIFTS;
+			}
+			else if ( _stricmp( pArg, "-allshifts" ) == 0 )
+			{
+				opt.bAllShifts = true;
+			}
+			else if ( _stricmp( pArg, "-interleave" ) == 0 )
+			{
+				specialNextArg = OPT_INTERLEAVE;
+			}
+			else if ( _stricmp( pArg, "-pf" ) == 0 )
+			{
+				specialNextArg = OPT_PIXEL_FORMAT;
+			}
+			else if ( _stricmp( pArg, "-tile" ) == 0 )
+			{
+				specialNextArg = OPT_TILE;
+			}
+			else if ( _stricmp( pArg, "-append" ) == 0 )
+			{
+				opt.bAppend = true;
+			}
+			else if ( _stricmp( pArg, "-2x" ) == 0 )
+			{
+				opt.loadImageScale.x = 2;
+				opt.loadImageScale.y = 1;
+			}
+			else if ( _stricmp( pArg, "-scale" ) == 0 )
+			{
+				specialNextArg = OPT_SCALE;
+			}
+			else if ( _stricmp( pArg, "-not" ) == 0 )
+			{
+				opt.bInvert = true;
+			}
+			else if ( pArg[ 1 ] == 'H' )
+			{
+				opt.header = pArg + 2;
+			}
+			else
+			{
+				// error.
+				PrintError( "Invalid parameter \"%s\".", pArg );
+				return 1;
+			}
+		}
+		else if ( opt.pInputName == nullptr )
+		{
+			opt.pInputName = pArg;
+		}
+		else if ( opt.pOutputName == nullptr )
+		{
+			opt.pOutputName = pArg;
+		}
+		else
+		{
+			// error.
+			PrintError( "Invalid parameter \"%s\".", pArg );
+			return 1;
+		}
+	}
+
+	if ( opt.pInputName == nullptr || opt.pOutputName == nullptr )
+	{
+		PrintHelp( "sprite" );
+		return 1;
+	}
+
+	// Keep stdout for the output.
+	if ( IsStdStream( opt.pOutputName ) )
+	{
+		MessagesToStderr();
+	}
+
+	return 0; // OK
+}
+
+//==============================================================================
+
+// Bytes in one interleaved output row, for mask and data rows of 'pitch' bytes.
+static int InterleavedPitch( int pitch, eInterleave interleave, int planeBytes, int unitBytes )
+{
+	if ( interleave == eInterleave::PLANE )
+	{
+		return pitch + ( pitch / unitBytes ) * planeBytes;
+	}
+
+	return pitch * 2;
+}
+
+// Weave one mask row and one data row, each 'pitch' bytes, into pDst.
+static void InterleaveRow( const uint8_t* pMask, const uint8_t* pData, int pitch, eInterleave interleave, int planeBytes, int unitBytes, uint8_t* pDst )
+{
+	switch ( interleave )
+	{
+
+	case eInterleave::BYTE:
+
+		for ( int i = 0; i < pitch; ++i )
+		{
+			*pDst++ = pMask[ i ];
+			*pDst++ = pData[ i ];
+		}
+
+		break;
+
+	case eInterleave::WORD:
+
+		// An odd last byte is written as a one byte pair.
+		for ( int i = 0; i < pitch; i += 2 )
+		{
+			const int n = ( pitch - i ) < 2 ? 1 : 2;
+			memcpy( pDst, pMask + i, n );
+			pDst += n;
+			memcpy( pDst, pData + i, n );
+			pDst += n;
+		}
+
+		break;
+
+	case eInterleave::ROW:
+
+		memcpy( pDst, pMask, pitch );
+		memcpy( pDst + pitch, pData, pitch );
+
+		break;
+
+	case eInterleave::PLANE:
+
+		// Every plane of a mask unit is the same, so one is enough.
+		for ( int i = 0; i < pitch; i += unitBytes )
+		{
+			memcpy( pDst, pMask + i, planeBytes );
+			pDst += planeBytes;
+			memcpy( pDst, pData + i, unitBytes );
+			pDst += unitBytes;
+		}
+
+		break;
+
+	}
+}
+
+// Instantiated once per output format (see DispatchPixelFormat). Builds one
+// interleaved output per shift in opt.shifts, each iPitch bytes by iHeight rows.
+template< typename TRAITS >
+static void BuildSprite( const Image& image, ImageInfo& imageInfo, const OptionsSprite& opt, std::vector< uint8_t >* pOutputs, int* pPitches )
+{
+	// Border pixels are implicitly index zero. TODO: Customise option?
+	const uint8_t borderValue = 0;
+
+	// Atari ST units are big-endian plane words. The byte formats have one plane per unit.
+	const int planeBytes = TRAITS::kBigEndian ? 2 : TRAITS::kUnitBytes;
+
+	const TileGrid grid( image, imageInfo, opt.iTileW, opt.iTileH );
+	const int iTileW = grid.iTileW;
+	const int iTileH = grid.iTileH;
+	const int rowCount = grid.GetRows();
+
+	const int shiftCount = static_cast< int >( opt.shifts.size() );
+
+	int maxShift = 0;
+	for ( int i = 0; i < shiftCount; ++i )
+	{
+		const int pitch = TRAITS::Pitch( iTileW + opt.shifts[ i ] );
+		pPitches[ i ] = InterleavedPitch( pitch, opt.interleave, planeBytes, TRAITS::kUnitBytes );
+		pOutputs[ i ].resize( static_cast< size_t >( pPitches[ i ] ) * rowCount );
+		maxShift = std::max( maxShift, opt.shifts[ i ] );
+	}
+
+	// Each tile row is masked and packed once, then shifted in the packed domain
+	// into each output. The pixels revealed on the left are filled from one packed
+	// unit of border.
+	const fnMaskRow maskRow = GetMaskRowKernel( opt.dataOutFormat );
+	const fnPackRow packRow = GetPackRowKernel( opt.dataOutFormat );
+	const fnShiftRow shiftRow = GetShiftRowKernel( opt.dataOutFormat );
+
+	const int shiftedPitch = TRAITS::Pitch( iTileW + maxShift );
+	std::vector< uint8_t > maskPacked( shiftedPitch );
+	std::vector< uint8_t > dataPacked( shiftedPitch );
+	std::vector< uint8_t > maskShifted( shiftedPitch );
+	std::vector< uint8_t > dataShifted( shiftedPitch );
+
+	uint8_t maskFill[ 64 ];
+	uint8_t dataFill[ 64 ];
+	{
+		uint8_t border[ TRAITS::kUnitPixels ];
+		memset( border, borderValue, sizeof( border ) );
+		maskRow( border, TRAITS::kUnitPixels, opt.maskIndices, opt.bInvert, maskFill );
+		packRow( border, TRAITS::kUnitPixels, dataFill );
+	}
+
+	ForEachTile( ImageView( image ), grid, [ & ]( const ImageView& tile, int dst_y0 )
+	{
+		for ( int iy = 0; iy < iTileH; ++iy )
+		{
+			const uint8_t* pSrc = tile.GetRowPtr( iy );
+
+			// Mask and pixels from the same source row.
+			maskRow( pSrc, iTileW, opt.maskIndices, opt.bInvert, maskPacked.data() );
+			packRow( pSrc, iTileW, dataPacked.data() );
+
+			for ( int i = 0; i < shiftCount; ++i )
+			{
+				const int shift = opt.shifts[ i ];
+				const uint8_t* pMask = maskPacked.data();
+				const uint8_t* pData = dataPacked.data();
+
+				if ( shift )
+				{
+					shiftRow( pMask, iTileW, shift, maskFill, maskShifted.data() );
+					shiftRow( pData, iTileW, shift, dataFill, dataShifted.data() );
+					pMask = maskShifted.data();
+					pData = dataShifted.data();
+				}
+
+				uint8_t* pDst = pOutputs[ i ].data() + static_cast< size_t >( pPitches[ i ] ) * ( dst_y0 + iy );
+				InterleaveRow( pMask, pData, TRAITS::Pitch( iTileW + shift ), opt.interleave, planeBytes, TRAITS::kUnitBytes, pDst );
+			}
+		}
+	} );
+}
+
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// Sprite
+//------------------------------------------------------------------------------
+int Sprite( int argc, char** argv )
+{
+	OptionsSprite opt;
+	Image image;
+	ImageInfo imageInfo;
+
+	// Get options
+	if ( ParseArgs( argc, argv, opt ) )
+	{
+		return 1; // ERROR
+	}
+
+	// Hardware sprite formats don't need a mask.
+	if ( PixelFormatIsPattern8x8( opt.dataOutFormat ) )
+	{
+		PrintError( "The '%s' pixel format is not supported by sprite.", PixelFormatToString( opt.dataOutFormat ) );
+		return 1; // ERROR
+	}
+
+	// Load image
+	if ( LoadImage( opt.pInputName, image, imageInfo, opt.loadImageScale ) )
+	{
+		return 1; // ERROR
+	}
+
+	// Within acceptable maximum index?
+	CheckMaxIndex( imageInfo, opt.dataOutFormat );
+
+	// Build sprite
+	Info( "Generating '%s' format sprite with a mask from palette index %s.\n", PixelFormatToString( opt.dataOutFormat ), IndexSetToString( opt.maskIndices ).c_str() );
+
+	// Shift / validated
+	if ( opt.bAllShifts )
+	{
+		opt.shifts = AllShifts( opt.dataOutFormat );
+	}
+	PrintShifts( opt.shifts );
+
+	int tileCount;
+	if ( opt.iTileW )
+	{
+		tileCount = ( imageInfo.width / opt.iTileW ) * ( imageInfo.height / opt.iTileH );
+
+		if ( tileCount <= 0 )
+		{
+			PrintError( "Image is too small to create tiles." );
+			return 1; // ERROR
+		}
+
+		Info( "Splitting input into %d tiles of %dx%d pixels.\n", tileCount, opt.iTileW, opt.iTileH );
+	}
+	else
+	{
+		// patch data for header system.
+		tileCount = 1; // whole image is one "tile"
+	}
+
+	std::vector< std::vector< uint8_t > > outputs( opt.shifts.size() );
+	std::vector< int > pitches( opt.shifts.size() );
+
+	DispatchPixelFormat( opt.dataOutFormat, [ & ]( auto traits )
+	{
+		BuildSprite< decltype( traits ) >( image, imageInfo, opt, outputs.data(), pitches.data() );
+	} );
+
+	// Write output, one shift after another.
+	const int iSpriteW = opt.iTileW ? opt.iTileW : imageInfo.width;
+	const int rowCount = opt.iTileW ? opt.iTileH * tileCount : imageInfo.height;
+
+	FileWriter out;
+	if ( OpenOutput_Fbin( out, opt.pOutputName, opt.bAppend ) == false )
+	{
+		return 1; // ERROR
+	}
+
+	for ( size_t i = 0; i < outputs.size(); ++i )
+	{
+		if ( WriteRows_Fbin( out, outputs[ i ].data(), iSpriteW + opt.shifts[ i ], pitches[ i ], rowCount, opt.header, opt.bAppend || i > 0, tileCount, opt.iTileH ) )
+		{
+			return 1; // ERROR
+		}
+	}
+
+	// Only now is the output file replaced.
+	return CloseOutput_Fbin( out );
+}
+
+//==============================================================================
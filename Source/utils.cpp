@@ -22,6 +22,7 @@ SOFTWARE.
 
 */
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <errno.h>
@@ -33,11 +34,16 @@ SOFTWARE.
 #include "Image.h"
 #include "ImageInfo.h"
 #include "FileReader.h"
+#include "FileWriter.h"
 #include "Loader.h"
+#include "IndexSet.h"
 
 // from ImageTools.cpp
 extern const char* gpActiveToolName;
 
+// Where Info and PrintError go. See MessagesToStderr.
+static FILE* gpMessages = stdout;
+
 
 //------------------------------------------------------------------------------
 // NextPowerTwo
@@ -274,6 +280,22 @@ void TestParsingSizes()
 	}
 }
 
+//------------------------------------------------------------------------------
+// IsStdStream
+//------------------------------------------------------------------------------
+bool IsStdStream( const char* pName )
+{
+	return pName && strcmp( pName, "-" ) == 0;
+}
+
+//------------------------------------------------------------------------------
+// MessagesToStderr
+//------------------------------------------------------------------------------
+void MessagesToStderr()
+{
+	gpMessages = stderr;
+}
+
 //------------------------------------------------------------------------------
 // PrintError
 //------------------------------------------------------------------------------
@@ -290,14 +312,14 @@ void PrintError( const char* pName, ... )
 
 	if ( gpActiveToolName )
 	{
-		printf( "%s:", gpActiveToolName );
+		fprintf( gpMessages, "%s:", gpActiveToolName );
 	}
 	else
 	{
-		printf( "ImageTools:" );
+		fprintf( gpMessages, "ImageTools:" );
 	}
 
-	printf( " ERROR: %s\n", buffer );
+	fprintf( gpMessages, " ERROR: %s\n", buffer );
 }
 
 //------------------------------------------------------------------------------
@@ -316,96 +338,83 @@ void Info( const char* pName, ... )
 
 	if ( gpActiveToolName )
 	{
-		printf( "%s:", gpActiveToolName );
+		fprintf( gpMessages, "%s:", gpActiveToolName );
+	}
+	else
+	{
+		fprintf( gpMessages, "ImageTools: " );
+	}
+
+	fprintf( gpMessages, " %s", buffer );
+}
+
+// Finish the "Loading" message for LoadImage / OpenImageRows.
+static int reportLoaded( bool bLoadResult, ImageInfo& imageInfo, const LoadImageScale& scale )
+{
+	// Failed?
+	if ( bLoadResult )
+	{
+		// Patch image info
+		imageInfo.width *= scale.x;
+		imageInfo.height *= scale.y;
+
+		if ( scale.x == 1 && scale.y == 1 )
+		{
+			fprintf( gpMessages, "OK (%dx%d)\n", imageInfo.width, imageInfo.height );
+		}
+		else if ( scale.y == 1 )
+		{
+			fprintf( gpMessages, "OK (%dx%d) [%dx]\n", imageInfo.width, imageInfo.height, scale.x );
+		}
+		else
+		{
+			fprintf( gpMessages, "OK (%dx%d) [%dx%d]\n", imageInfo.width, imageInfo.height, scale.x, scale.y );
+		}
 	}
 	else
 	{
-		printf( "ImageTools: " );
+		PrintError( "Failed to load image." );
+		return 1;
 	}
 
-	printf( " %s", buffer );
+	return 0;
 }
 
 //------------------------------------------------------------------------------
 // LoadImage
 //------------------------------------------------------------------------------
-int LoadImage( const char* pInputName, Image& image, ImageInfo& imageInfo, eLoadImageMode loadImageMode )
+int LoadImage( const char* pInputName, Image& image, ImageInfo& imageInfo, const LoadImageScale& scale )
 {
 	FileReader reader;
 	Loader imgLoader;
 
 	Info( "Loading \"%s\" ... ", pInputName );
 
-	// Load image
+	// Load image, scaling each row as it's decoded.
 	bool bLoadResult = false;
 	if ( reader.LoadFile( pInputName ) )
 	{
-		switch ( loadImageMode )
-		{
-
-		case eLoadImageMode::DEFAULT:
-			bLoadResult = imgLoader.LoadTo( reader, image, &imageInfo, Loader::WANT_IDX8 );
-			break;
-
-		case eLoadImageMode::SCALE_2X:
-
-			{
-				Image temp;
-
-				bLoadResult = imgLoader.LoadTo( reader, temp, &imageInfo, Loader::WANT_IDX8 );
-
-				if ( bLoadResult )
-				{
-					// Duplicate image at 2x width.
-					image.Create( temp.GetPixelFormat(), temp.GetWidth() * 2, temp.GetHeight() );
-
-					for ( uint32_t y = 0; y < temp.GetHeight(); ++y )
-					{
-						for ( uint32_t x = 0; x < temp.GetWidth(); ++x )
-						{
-							// ... read source image.
-							uint32_t copy;
-							copy = temp.Peek( x, y );
-
-							// ... write to image, twice.
-							image.Plot( x * 2, y, copy );
-							image.Plot( ( x * 2 ) + 1, y, copy );
-						}
-					}
-
-					// Patch image info
-					imageInfo.width *= 2;
-				}
-			}
-
-			break;
-
-		}; // switch ( loadImageMode )
+		bLoadResult = imgLoader.LoadTo( reader, image, &imageInfo, Loader::WANT_IDX8, scale.x, scale.y );
 	}
 
-	// Failed?
-	if ( bLoadResult )
-	{
-		switch ( loadImageMode )
-		{
-
-		case eLoadImageMode::DEFAULT:
-			printf( "OK (%dx%d)\n", imageInfo.width, imageInfo.height );
-			break;
+	return reportLoaded( bLoadResult, imageInfo, scale );
+}
 
-		case eLoadImageMode::SCALE_2X:
-			printf( "OK (%dx%d) [2x]\n", imageInfo.width, imageInfo.height );
-			break;
+//------------------------------------------------------------------------------
+// OpenImageRows
+//------------------------------------------------------------------------------
+int OpenImageRows( const char* pInputName, FileReader& reader, Loader& loader, ImageInfo& imageInfo, const LoadImageScale& scale )
+{
+	Info( "Loading \"%s\" ... ", pInputName );
 
-		}
-	}
-	else
+	// Start reading, scaling each row as it's decoded.
+	bool bLoadResult = false;
+	if ( reader.LoadFile( pInputName ) )
 	{
-		PrintError( "Failed to load image." );
-		return 1;
+		bLoadResult = loader.BeginRows( reader, &imageInfo, scale.x, scale.y );
 	}
 
-	return 0;
+	return reportLoaded( bLoadResult, imageInfo, scale );
 }
 
 //------------------------------------------------------------------------------
@@ -413,10 +422,10 @@ int LoadImage( const char* pInputName, Image& image, ImageInfo& imageInfo, eLoad
 //------------------------------------------------------------------------------
 void PrintImage( Image& image )
 {
-	for ( int y = 0; y < image.GetHeight(); ++y )
+	for ( uint32_t y = 0; y < image.GetHeight(); ++y )
 	{
 		uint8_t* p = image.GetRowPtr( y );
-		for ( int i = 0; i < image.GetPitch(); ++i )
+		for ( uint32_t i = 0; i < image.GetPitch(); ++i )
 		{
 			printf( "%02X", p[ i ] );
 		}
@@ -425,25 +434,30 @@ void PrintImage( Image& image )
 }
 
 
-static void write_value_helper( FILE* fp_out, int iSize, bool bLittleEnd, uint32_t data )
+static void write_value_helper( FileWriter& out, int iSize, bool bLittleEnd, uint32_t data )
 {
+	uint8_t bytes[ 2 ];
+
 	switch ( iSize )
 	{
 
 	case 1:
-		fputc( static_cast<uint8_t>( data ), fp_out );
+		bytes[ 0 ] = static_cast<uint8_t>( data );
+		out.Write( bytes, 1 );
 		break;
 
 	case 2:
 		if ( bLittleEnd )
 		{
-			fwrite( &data, 2, 1, fp_out );
+			bytes[ 0 ] = static_cast<uint8_t>( data );
+			bytes[ 1 ] = static_cast<uint8_t>( data >> 8 );
 		}
 		else
 		{
-			fputc( static_cast<uint8_t>( data >> 8 ), fp_out );
-			fputc( static_cast<uint8_t>( data ), fp_out );
+			bytes[ 0 ] = static_cast<uint8_t>( data >> 8 );
+			bytes[ 1 ] = static_cast<uint8_t>( data );
 		}
+		out.Write( bytes, 2 );
 		break;
 
 	}
@@ -452,7 +466,12 @@ static void write_value_helper( FILE* fp_out, int iSize, bool bLittleEnd, uint32
 //------------------------------------------------------------------------------
 // WriteOutHeader
 //------------------------------------------------------------------------------
-void WriteOutHeader( Image& image, std::string& header, FILE* fp_out, int iTileCount, int iTileHeight )
+void WriteOutHeader( Image& image, std::string& header, FileWriter& out, int iTileCount, int iTileHeight )
+{
+	WriteOutHeader( image.GetWidth(), image.GetPitch(), header, out, iTileCount, iTileHeight );
+}
+
+void WriteOutHeader( int iWidth, int iPitch, std::string& header, FileWriter& out, int iTileCount, int iTileHeight )
 {
 	// State
 	int iSize = 1;
@@ -482,23 +501,23 @@ void WriteOutHeader( Image& image, std::string& header, FILE* fp_out, int iTileC
 			break;
 
 		case 'z':
-			write_value_helper( fp_out, iSize, bLittleEnd, 0 );
+			write_value_helper( out, iSize, bLittleEnd, 0 );
 			break;
 
 		case 'p':
-			write_value_helper( fp_out, iSize, bLittleEnd, image.GetPitch() / iSize );
+			write_value_helper( out, iSize, bLittleEnd, iPitch / iSize );
 			break;
 
 		case 'w':
-			write_value_helper( fp_out, iSize, bLittleEnd, image.GetWidth() );
+			write_value_helper( out, iSize, bLittleEnd, iWidth );
 			break;
 
 		case 'h':
-			write_value_helper( fp_out, iSize, bLittleEnd, iTileHeight );
+			write_value_helper( out, iSize, bLittleEnd, iTileHeight );
 			break;
 
 		case 'n':
-			write_value_helper( fp_out, iSize, bLittleEnd, iTileCount );
+			write_value_helper( out, iSize, bLittleEnd, iTileCount );
 			break;
 
 		}; // switch ( ch )
@@ -508,32 +527,70 @@ void WriteOutHeader( Image& image, std::string& header, FILE* fp_out, int iTileC
 //------------------------------------------------------------------------------
 // WriteImage
 //------------------------------------------------------------------------------
-void WriteImage( Image& image, FILE* fp_out )
+void WriteImage( Image& image, FileWriter& out )
 {
-	for ( int y = 0; y < image.GetHeight(); ++y )
+	// Packed rows join up into one piece.
+	for ( uint32_t y = 0; y < image.GetHeight(); ++y )
 	{
-		uint8_t* p = image.GetRowPtr( y );
-		for ( int i = 0; i < image.GetPitch(); ++i )
-		{
-			fputc( p[ i ], fp_out );
-		}
+		out.WriteRef( image.GetRowPtr( y ), image.GetPitch() );
+	}
+
+	out.Flush();
+}
+
+//------------------------------------------------------------------------------
+// DecodeLoadImageScale
+//------------------------------------------------------------------------------
+bool DecodeLoadImageScale( const char* pString, LoadImageScale& scale )
+{
+	char* pEnd = nullptr;
+	const long x = strtol( pString, &pEnd, 10 );
+
+	if ( *pEnd != 'x' && *pEnd != 'X' )
+	{
+		return false;
 	}
+
+	const long y = strtol( pEnd + 1, &pEnd, 10 );
+
+	if ( *pEnd != 0 || x < 1 || x > 16 || y < 1 || y > 16 )
+	{
+		return false;
+	}
+
+	scale.x = static_cast< int >( x );
+	scale.y = static_cast< int >( y );
+
+	return true;
 }
 
 //------------------------------------------------------------------------------
-// ValidateLoadImageMode
+// CheckMaxIndex
 //------------------------------------------------------------------------------
-void ValidateLoadImageMode( PixelFormat pf, eLoadImageMode& mode )
+void CheckMaxIndex( const ImageInfo& imageInfo, PixelFormat pf )
 {
-	if ( mode == eLoadImageMode::SCALE_2X )
+	const uint32_t uMaxPermittedIndex = PixelFormatMaxIndex( pf );
+	if ( uMaxPermittedIndex > 0 && imageInfo.uMaxIndex >= uMaxPermittedIndex )
+	{
+		Info( "WARNING: Image contains an index (#%d) which exceeds the maximum limit.\n", imageInfo.uMaxIndex );
+		Info( "WARNING: Pixel format requires indices from 0 to %d.\n", uMaxPermittedIndex - 1 );
+	}
+}
+
+//------------------------------------------------------------------------------
+// ValidateLoadImageScale
+//------------------------------------------------------------------------------
+void ValidateLoadImageScale( PixelFormat pf, LoadImageScale& scale )
+{
+	if ( scale.x != 1 || scale.y != 1 )
 	{
 		if ( pf == PixelFormat::GAMEBOY ||
 			 pf == PixelFormat::MASTER_SYSTEM ||
 			 pf == PixelFormat::NES )
 		{
 			// Disable
-			Info( "WARNING: -2x is not supported for this pixel format.\n" );
-			mode = eLoadImageMode::DEFAULT;
+			Info( "WARNING: -2x and -scale are not supported for this pixel format.\n" );
+			scale = LoadImageScale();
 		}
 	}
 }
@@ -541,9 +598,9 @@ void ValidateLoadImageMode( PixelFormat pf, eLoadImageMode& mode )
 //------------------------------------------------------------------------------
 // ValidateShift
 //------------------------------------------------------------------------------
-void ValidateShift( PixelFormat pf, int& iShift )
+void ValidateShift( PixelFormat pf, std::vector< int >& shifts )
 {
-	if ( iShift )
+	if ( shifts.size() > 1 || shifts[ 0 ] != 0 )
 	{
 		if ( pf == PixelFormat::GAMEBOY ||
 			 pf == PixelFormat::MASTER_SYSTEM ||
@@ -551,28 +608,67 @@ void ValidateShift( PixelFormat pf, int& iShift )
 		{
 			// Disable
 			Info( "WARNING: -shift is not supported for this pixel format.\n" );
-			iShift = 0;
+			shifts = { 0 };
 		}
 	}
 }
 
 //------------------------------------------------------------------------------
-// WriteImage_Fbin
+// DecodeShifts
 //------------------------------------------------------------------------------
-int WriteImage_Fbin( Image& image, const char* pOutputName, std::string& header, bool bAppend, int iTileCount, int iTileHeight )
+bool DecodeShifts( const char* pStr, std::vector< int >& shifts )
 {
-	int err;
-	FILE* fp_out;
+	// Same syntax as a set of indices.
+	IndexSet set;
+	if ( DecodeIndexSet( pStr, set ) == false )
+	{
+		return false;
+	}
 
-	// ... output file
-	err = fopen_s( &fp_out, pOutputName, bAppend ? "ab" : "wb" );
-	if ( err != 0 || fp_out == nullptr )
+	shifts.clear();
+	for ( int i = 0; i < 256; ++i )
 	{
-		PrintError( "Cannot open output file \"%s\"", pOutputName );
-		return 1;
+		if ( set.Contains( static_cast< uint8_t >( i ) ) )
+		{
+			shifts.push_back( i );
+		}
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// AllShifts
+//------------------------------------------------------------------------------
+std::vector< int > AllShifts( PixelFormat pf )
+{
+	std::vector< int > shifts;
+	for ( int i = 0; i < PixelFormatUnitPixels( pf ); ++i )
+	{
+		shifts.push_back( i );
 	}
 
-	// Write
+	return shifts;
+}
+
+//------------------------------------------------------------------------------
+// PrintShifts
+//------------------------------------------------------------------------------
+void PrintShifts( const std::vector< int >& shifts )
+{
+	if ( shifts.size() > 1 )
+	{
+		Info( "Output is %d copies, shifted right by %d to %d pixels.\n", static_cast< int >( shifts.size() ), shifts.front(), shifts.back() );
+	}
+	else if ( shifts[ 0 ] )
+	{
+		Info( "Output is shifted right by %d pixels.\n", shifts[ 0 ] );
+	}
+}
+
+// Start the message for each image written to the output file.
+static void sayWriting( FileWriter& out, bool bAppend )
+{
 	if ( bAppend )
 	{
 		Info( "Appending" );
@@ -581,17 +677,147 @@ int WriteImage_Fbin( Image& image, const char* pOutputName, std::string& header,
 	{
 		Info( "Writing" );
 	}
-	printf( " \"%s\" ... ", pOutputName );
+	fprintf( gpMessages, " \"%s\" ... ", out.GetName().c_str() );
+}
+
+//------------------------------------------------------------------------------
+// OpenOutput_Fbin
+//------------------------------------------------------------------------------
+bool OpenOutput_Fbin( FileWriter& out, const char* pOutputName, bool bAppend )
+{
+	if ( out.Open( pOutputName, bAppend ) == false )
+	{
+		PrintError( "Cannot open output file \"%s\"", pOutputName );
+		return false;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// CloseOutput_Fbin
+//------------------------------------------------------------------------------
+int CloseOutput_Fbin( FileWriter& out )
+{
+	if ( out.Close() == false )
+	{
+		PrintError( "Failed to write output file \"%s\"", out.GetName().c_str() );
+		return 1;
+	}
+
+	if ( out.IsUnchanged() )
+	{
+		Info( "\"%s\" is unchanged, so was left alone.\n", out.GetName().c_str() );
+	}
+
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+// WriteImage_Fbin
+//------------------------------------------------------------------------------
+int WriteImage_Fbin( FileWriter& out, Image& image, std::string& header, bool bAppend, int iTileCount, int iTileHeight )
+{
+	BeginImage_Fbin( out, image, header, bAppend, iTileCount, iTileHeight );
+
+	// Image, with the header in one write.
+	WriteImage( image, out );
+
+	return EndImage_Fbin( out );
+}
+
+//------------------------------------------------------------------------------
+// BeginImage_Fbin
+//------------------------------------------------------------------------------
+void BeginImage_Fbin( FileWriter& out, Image& image, std::string& header, bool bAppend, int iTileCount, int iTileHeight )
+{
+	sayWriting( out, bAppend );
+
+	// Header, written along with the first rows.
+	WriteOutHeader( image, header, out, iTileCount, iTileHeight );
+}
+
+//------------------------------------------------------------------------------
+// EndImage_Fbin
+//------------------------------------------------------------------------------
+int EndImage_Fbin( FileWriter& out )
+{
+	if ( out.Flush() == false )
+	{
+		PrintError( "Failed to write output file." );
+		return 1;
+	}
+
+	fprintf( gpMessages, "DONE (%ld bytes)\n", out.GetFileSize() );
+
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+// OpenSpill_Fbin
+//------------------------------------------------------------------------------
+bool OpenSpill_Fbin( FileWriter& spill )
+{
+	if ( spill.OpenTemp() == false )
+	{
+		PrintError( "Cannot create a temporary file." );
+		return false;
+	}
+
+	return true;
+}
 
-	// Header
-	WriteOutHeader( image, header, fp_out, iTileCount, iTileHeight );
-	
-	// Image
-	WriteImage( image, fp_out );
-	
-	printf( "DONE (%d bytes)\n", ftell( fp_out ) );
-	fclose( fp_out );
+//------------------------------------------------------------------------------
+// CopySpill_Fbin
+//------------------------------------------------------------------------------
+int CopySpill_Fbin( FileWriter& spill, FileWriter& out )
+{
+	const bool bResult = spill.CopyTo( out ) && spill.Close();
+
+	if ( bResult == false )
+	{
+		PrintError( "Failed to copy a temporary file." );
+		return 1;
+	}
 
 	return 0;
 }
 
+//------------------------------------------------------------------------------
+// StreamBandHeight
+//------------------------------------------------------------------------------
+int StreamBandHeight( int64_t iMaxMem, int iWidth, int iHeight, int iUnitH, int iDefaultH, int iOutputs )
+{
+	if ( iMaxMem <= 0 )
+	{
+		return iDefaultH;
+	}
+
+	// A CHUNKY_8 input row, plus a row per output. No output format has more
+	// than a byte per pixel, so the input row's size covers each of them.
+	const int64_t iRowBytes = static_cast< int64_t >( iWidth + 64 ) * ( 1 + iOutputs );
+
+	int64_t iUnits = iMaxMem / ( iRowBytes * iUnitH );
+	if ( iUnits < 1 )
+	{
+		Info( "WARNING: -maxmem is too small for one band of %d rows. Using one anyway.\n", iUnitH );
+		iUnits = 1;
+	}
+
+	const int64_t iMaxUnits = ( iHeight + iUnitH - 1 ) / iUnitH;
+	return static_cast< int >( std::min( iUnits, std::max< int64_t >( iMaxUnits, 1 ) ) * iUnitH );
+}
+
+//------------------------------------------------------------------------------
+// WriteRows_Fbin
+//------------------------------------------------------------------------------
+int WriteRows_Fbin( FileWriter& out, const uint8_t* pRows, int iWidth, int iPitch, int iHeight, std::string& header, bool bAppend, int iTileCount, int iTileHeight )
+{
+	sayWriting( out, bAppend );
+
+	// Header and rows, in one write.
+	WriteOutHeader( iWidth, iPitch, header, out, iTileCount, iTileHeight );
+	out.WriteRef( pRows, static_cast< size_t >( iPitch ) * iHeight );
+
+	return EndImage_Fbin( out );
+}
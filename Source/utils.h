@@ -26,10 +26,15 @@ SOFTWARE.
 
 #include <cstdint>
 #include <string>
+#include <vector>
+
+#include "PixelFormat.h"
 
 class Image;
+class FileReader;
+class FileWriter;
+class Loader;
 struct ImageInfo;
-enum class PixelFormat;
 
 
 //------------------------------------------------------------------------------
@@ -73,31 +78,93 @@ void PrintError( const char* pName, ... );
 // Print a standard info message to stdout. Doesn't end with an extra newline.
 void Info( const char* pName, ... );
 
-enum class eLoadImageMode
+// Is this file name "-", meaning stdin or stdout?
+bool IsStdStream( const char* pName );
+
+// Send Info, PrintError and progress messages to stderr, so that stdout only
+// carries output data.
+void MessagesToStderr();
+
+// Scale up an image as it's loaded, by repeating pixels.
+struct LoadImageScale
 {
-	DEFAULT,
-	SCALE_2X,
+	int x = 1;
+	int y = 1;
 };
 
 // Helper to load an image. Return 0 on success, 1 on error.
-int LoadImage( const char* pInputName, Image& image, ImageInfo& imageInfo, eLoadImageMode loadImageMode );
+int LoadImage( const char* pInputName, Image& image, ImageInfo& imageInfo, const LoadImageScale& scale );
+
+// Helper to start reading an image a row at a time, with loader.ReadRow. The
+// reader and loader must outlive the rows. Return 0 on success, 1 on error.
+int OpenImageRows( const char* pInputName, FileReader& reader, Loader& loader, ImageInfo& imageInfo, const LoadImageScale& scale );
 
 // Print an image as ASCII, be careful with larger sizes!
 void PrintImage( Image& image );
 
-// Write an image to a file, Return 0 on success, 1 on error. 
-int WriteImage_Fbin( Image& image, const char* pOutputName, std::string& header, bool bAppend, int iTileCount, int iTileHeight );
+// Open the output file, for one or more images. Nothing replaces the file until
+// CloseOutput_Fbin, which leaves it alone if its contents haven't changed.
+// Return false on error.
+bool OpenOutput_Fbin( FileWriter& out, const char* pOutputName, bool bAppend );
+
+// Finish the output file. Return 0 on success, 1 on error.
+int CloseOutput_Fbin( FileWriter& out );
+
+// Write an image to the output file. bAppend only changes the message, as every
+// image after the first is appended. Return 0 on success, 1 on error.
+int WriteImage_Fbin( FileWriter& out, Image& image, std::string& header, bool bAppend, int iTileCount, int iTileHeight );
+
+// Write an image to the output file a band at a time. 'image' is the first band,
+// and only sets up the header. Write each band with WriteImage, then call
+// EndImage_Fbin.
+void BeginImage_Fbin( FileWriter& out, Image& image, std::string& header, bool bAppend, int iTileCount, int iTileHeight );
+
+// Finish an image started with BeginImage_Fbin. Return 0 on success, 1 on error.
+int EndImage_Fbin( FileWriter& out );
+
+// Write rows of iPitch bytes to the output file, with a header describing them as
+// iWidth pixels wide. Return 0 on success, 1 on error.
+int WriteRows_Fbin( FileWriter& out, const uint8_t* pRows, int iWidth, int iPitch, int iHeight, std::string& header, bool bAppend, int iTileCount, int iTileHeight );
+
+// Open a temporary file to hold output that must wait its turn to be written.
+// It's deleted when closed. Return false on error.
+bool OpenSpill_Fbin( FileWriter& spill );
+
+// Copy everything written to a spill file onto the end of 'out', then close the
+// spill. Return 0 on success, 1 on error.
+int CopySpill_Fbin( FileWriter& spill, FileWriter& out );
+
+// Rows per band when streaming an image iWidth pixels wide into iOutputs outputs,
+// in whole units of iUnitH rows, and no more than iHeight rounded up to a unit.
+// Zero iMaxMem means no budget, and gives iDefaultH.
+int StreamBandHeight( int64_t iMaxMem, int iWidth, int iHeight, int iUnitH, int iDefaultH, int iOutputs );
 
 // Write a flexible header
-void WriteOutHeader( Image& image, std::string& header, FILE* fp_out, int iTileCount, int iTileHeight );
+void WriteOutHeader( Image& image, std::string& header, FileWriter& out, int iTileCount, int iTileHeight );
+void WriteOutHeader( int iWidth, int iPitch, std::string& header, FileWriter& out, int iTileCount, int iTileHeight );
+
+// Write an image's rows after anything already queued, in one go.
+void WriteImage( Image& image, FileWriter& out );
 
-// Write an image to a standard stream
-void WriteImage( Image& image, FILE* fp_out );
+// Decode a -scale parameter "NxM". Return false if it's invalid.
+bool DecodeLoadImageScale( const char* pString, LoadImageScale& scale );
 
-// Validate eLoadImageMode option. Disable for tile-map formats, with a warning.
-void ValidateLoadImageMode( PixelFormat pf, eLoadImageMode& mode );
+// Warn if the image uses an index beyond what a pixel format can hold.
+void CheckMaxIndex( const ImageInfo& imageInfo, PixelFormat pf );
+
+// Validate LoadImageScale option. Disable for tile-map formats, with a warning.
+void ValidateLoadImageScale( PixelFormat pf, LoadImageScale& scale );
+
+// Decode a -shifts list of shifts and ranges, e.g. "0-7". Returns false if it's invalid.
+bool DecodeShifts( const char* pStr, std::vector< int >& shifts );
+
+// Every shift within one byte or block of a pixel format, e.g. 0 to 7 for 1bpp.
+std::vector< int > AllShifts( PixelFormat pf );
 
 // Validate shift option. Disable for tile-map formats, with a warning.
-void ValidateShift( PixelFormat pf, int& iShift );
+void ValidateShift( PixelFormat pf, std::vector< int >& shifts );
+
+// Describe the shifts that will be output.
+void PrintShifts( const std::vector< int >& shifts );
 
 //==============================================================================